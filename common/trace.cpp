@@ -0,0 +1,259 @@
+#ifdef OSC_TRACE
+
+#include "trace.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Spans kept per thread; the oldest are overwritten past this
+const size_t DEFAULT_EVENTS_PER_THREAD = 16384;
+
+// Buffers of exited threads kept for the dump, so programs that start
+// threads all day don't grow without bound
+const size_t MAX_RETIRED_BUFFERS = 256;
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    const char* detail;
+    uint64_t start;
+    uint64_t end;
+};
+
+struct TraceBuffer {
+    vector<TraceEvent> events;  // Power-of-two ring
+    atomic<uint64_t> recorded;
+    long tid;
+    string thread_name;
+
+    explicit TraceBuffer(size_t capacity) : events(capacity), recorded(0), tid(syscall(SYS_gettid)) {}
+};
+
+uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+struct TraceRegistry {
+    mutex lock;
+    vector<TraceBuffer*> live;
+    deque<TraceBuffer*> retired;
+    string process_name;
+    size_t capacity;
+    // trace_clock() and CLOCK_MONOTONIC read together; a second pair taken
+    // when dumping gives the tick rate
+    uint64_t anchor_ticks;
+    uint64_t anchor_ns;
+
+    TraceRegistry() : process_name("process"), capacity(DEFAULT_EVENTS_PER_THREAD) {
+        const char* events = getenv("OSC_TRACE_EVENTS");
+        if (events != NULL && strtoul(events, NULL, 10) > 0) {
+            capacity = strtoul(events, NULL, 10);
+        }
+        while (capacity & (capacity - 1)) {
+            capacity &= capacity - 1;  // Round down to a power of two
+        }
+        anchor_ticks = trace_clock();
+        anchor_ns = monotonic_ns();
+    }
+};
+
+// Never destroyed: threads may still record while the process exits
+TraceRegistry& registry() {
+    static TraceRegistry* instance = new TraceRegistry();
+    return *instance;
+}
+
+// Hands the calling thread's buffer to the registry when the thread exits
+struct ThreadTrace {
+    TraceBuffer* buffer;
+    string pending_name;
+
+    ThreadTrace() : buffer(NULL) {}
+    ~ThreadTrace() {
+        if (buffer == NULL) {
+            return;
+        }
+        TraceRegistry& r = registry();
+        lock_guard<mutex> guard(r.lock);
+        for (size_t i = 0; i < r.live.size(); i++) {
+            if (r.live[i] == buffer) {
+                r.live.erase(r.live.begin() + i);
+                break;
+            }
+        }
+        r.retired.push_back(buffer);
+        if (r.retired.size() > MAX_RETIRED_BUFFERS) {
+            delete r.retired.front();
+            r.retired.pop_front();
+        }
+    }
+};
+
+thread_local ThreadTrace current;
+
+TraceBuffer* register_thread() {
+    TraceRegistry& r = registry();
+    TraceBuffer* buffer = new TraceBuffer(r.capacity);
+    buffer->thread_name = current.pending_name;
+    lock_guard<mutex> guard(r.lock);
+    r.live.push_back(buffer);
+    return buffer;
+}
+
+void write_json_string(FILE* out, const string& text) {
+    fputc('"', out);
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            fputc('\\', out);
+        }
+        if (static_cast<unsigned char>(c) >= 0x20) {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+bool dump(TraceRegistry& r, const string& path);
+
+string dump_path() {
+    const char* dir = getenv("OSC_TRACE_DIR");
+    return string(dir != NULL ? dir : ".") + "/" + registry().process_name + "." +
+           to_string(getpid()) + ".trace.json";
+}
+
+void dump_at_exit() {
+    trace_dump(dump_path());
+}
+
+// A crash is when the trace is most wanted. Writing it from a signal
+// handler is not async-signal-safe, so this is best effort: it is skipped
+// if the crashing thread held the registry lock.
+void dump_on_crash(int signal_number) {
+    TraceRegistry& r = registry();
+    if (r.lock.try_lock()) {
+        dump(r, dump_path());
+        r.lock.unlock();
+    }
+    raise(signal_number);  // The handler was reset, so this terminates as before
+}
+
+}  // namespace
+
+void trace_init(const char* process_name) {
+    registry().process_name = process_name;
+    atexit(dump_at_exit);
+
+    struct sigaction action = {};
+    action.sa_handler = dump_on_crash;
+    action.sa_flags = SA_RESETHAND;
+    for (int signal_number : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT}) {
+        sigaction(signal_number, &action, NULL);
+    }
+}
+
+void trace_thread_name(const string& name) {
+    if (current.buffer == NULL) {
+        current.pending_name = name;  // Picked up when the thread first records
+        return;
+    }
+    lock_guard<mutex> guard(registry().lock);
+    current.buffer->thread_name = name;
+}
+
+void trace_record(const char* name, const char* category, const char* detail, uint64_t start, uint64_t end) {
+    TraceBuffer* buffer = current.buffer;
+    if (buffer == NULL) {
+        buffer = current.buffer = register_thread();
+    }
+    uint64_t n = buffer->recorded.load(memory_order_relaxed);
+    TraceEvent& event = buffer->events[n & (buffer->events.size() - 1)];
+    event.name = name;
+    event.category = category;
+    event.detail = detail;
+    event.start = start;
+    event.end = end;
+    buffer->recorded.store(n + 1, memory_order_release);
+}
+
+bool trace_dump(const string& path) {
+    TraceRegistry& r = registry();
+    lock_guard<mutex> guard(r.lock);
+    return dump(r, path);
+}
+
+namespace {
+
+// Called with the registry lock held
+bool dump(TraceRegistry& r, const string& path) {
+    uint64_t ticks = trace_clock();
+    uint64_t ns = monotonic_ns();
+    double ns_per_tick = ticks > r.anchor_ticks ? static_cast<double>(ns - r.anchor_ns) / (ticks - r.anchor_ticks) : 1.0;
+    auto to_us = [&](uint64_t t) {
+        return (r.anchor_ns + static_cast<int64_t>(t - r.anchor_ticks) * ns_per_tick) / 1000.0;
+    };
+
+    FILE* out = fopen(path.c_str(), "w");
+    if (out == NULL) {
+        perror(("trace: unable to write " + path).c_str());
+        return false;
+    }
+
+    // One event per line, so tracemerge can combine files without a JSON parser
+    int pid = getpid();
+    fprintf(out, "{\"traceEvents\": [\n");
+    fprintf(out, "{\"ph\": \"M\", \"name\": \"process_name\", \"pid\": %d, \"tid\": 0, \"args\": {\"name\": ", pid);
+    write_json_string(out, r.process_name);
+    fprintf(out, "}}");
+
+    vector<TraceBuffer*> buffers(r.retired.begin(), r.retired.end());
+    buffers.insert(buffers.end(), r.live.begin(), r.live.end());
+    uint64_t dropped = 0;
+    for (TraceBuffer* buffer : buffers) {
+        if (!buffer->thread_name.empty()) {
+            fprintf(out, ",\n{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": %d, \"tid\": %ld, \"args\": {\"name\": ",
+                    pid, buffer->tid);
+            write_json_string(out, buffer->thread_name);
+            fprintf(out, "}}");
+        }
+
+        uint64_t recorded = buffer->recorded.load(memory_order_acquire);
+        uint64_t first = recorded > buffer->events.size() ? recorded - buffer->events.size() : 0;
+        dropped += first;
+        for (uint64_t i = first; i < recorded; i++) {
+            const TraceEvent& event = buffer->events[i & (buffer->events.size() - 1)];
+            double start = to_us(event.start);
+            fprintf(out, ",\n{\"ph\": \"X\", \"name\": \"%s\", \"cat\": \"%s\", \"pid\": %d, \"tid\": %ld, "
+                    "\"ts\": %.3f, \"dur\": %.3f", event.name, event.category, pid, buffer->tid,
+                    start, to_us(event.end) - start);
+            if (event.detail != NULL) {
+                fprintf(out, ", \"args\": {\"detail\": \"%s\"}", event.detail);
+            }
+            fprintf(out, "}");
+        }
+    }
+    fprintf(out, "\n],\n\"displayTimeUnit\": \"ns\"}\n");
+    fclose(out);
+
+    if (dropped > 0) {
+        fprintf(stderr, "trace: %s: oldest %llu spans overwritten (OSC_TRACE_EVENTS raises the per-thread limit)\n",
+                path.c_str(), static_cast<unsigned long long>(dropped));
+    }
+    return true;
+}
+
+}  // namespace
+
+#endif
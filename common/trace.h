@@ -0,0 +1,83 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Span tracing shared by both projects. It is compiled in only with
+// -DOSC_TRACE (make TRACE=1, or cmake -DOSC_TRACE=ON); otherwise the macros
+// below expand to nothing and cost nothing.
+//
+// Each thread records into its own ring buffer, so a span takes no lock:
+// two clock reads and one store. At exit a process that called TRACE_INIT
+// writes its spans as Chrome Trace Event JSON to
+// $OSC_TRACE_DIR/<process>.<pid>.trace.json (the current directory by
+// default). tracemerge combines the files of several processes into one
+// timeline for chrome://tracing or ui.perfetto.dev; every process stamps
+// spans against CLOCK_MONOTONIC, so they line up.
+//
+// Span names, categories and details must be string literals: only the
+// pointers are kept.
+//
+//   TRACE_INIT("driver");                   // once, in main
+//   TRACE_THREAD_NAME("teller " + to_string(id));
+//   TRACE_SPAN("pipe write", "pipe");       // until the end of the scope
+//   TRACE_SPAN("wait", "semaphore", name);  // optional detail, shown as an arg
+
+#ifdef OSC_TRACE
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Raw timestamp: the TSC where there is one (converted to CLOCK_MONOTONIC
+// when the trace is written), otherwise CLOCK_MONOTONIC nanoseconds
+inline uint64_t trace_clock() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+// Names the process in the trace and writes the trace file at exit (and,
+// best effort, when the process crashes)
+void trace_init(const char* process_name);
+void trace_thread_name(const std::string& name);
+void trace_record(const char* name, const char* category, const char* detail, uint64_t start, uint64_t end);
+// Writes every span still held in the ring buffers; false if the file can't be written
+bool trace_dump(const std::string& path);
+
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* category, const char* detail = NULL)
+        : name(name), category(category), detail(detail), start(trace_clock()) {}
+    ~TraceSpan() { trace_record(name, category, detail, start, trace_clock()); }
+
+private:
+    TraceSpan(const TraceSpan&);
+    TraceSpan& operator=(const TraceSpan&);
+
+    const char* name;
+    const char* category;
+    const char* detail;
+    uint64_t start;
+};
+
+#define TRACE_JOIN_(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN_(a, b)
+#define TRACE_SPAN(...) TraceSpan TRACE_JOIN(trace_span_, __LINE__)(__VA_ARGS__)
+#define TRACE_INIT(process_name) trace_init(process_name)
+#define TRACE_THREAD_NAME(name) trace_thread_name(name)
+
+#else
+
+#define TRACE_SPAN(...) do {} while (0)
+#define TRACE_INIT(process_name) do {} while (0)
+#define TRACE_THREAD_NAME(name) do {} while (0)
+
+#endif
+
+#endif
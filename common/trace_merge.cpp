@@ -0,0 +1,39 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+
+using namespace std;
+
+// Combines the trace files written by trace.h (one per process) into one
+// Chrome Trace Event file on stdout, so a driver, its children and a bank
+// simulation run can be viewed on a single timeline.
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <trace.json>... > merged.json" << endl;
+        return 1;
+    }
+
+    cout << "{\"traceEvents\": [";
+    bool first = true;
+    for (int i = 1; i < argc; i++) {
+        ifstream file(argv[i]);
+        if (!file.is_open()) {
+            cerr << "Error: Unable to open " << argv[i] << endl;
+            return 1;
+        }
+        // Events are written one per line, each starting with {"ph"
+        string line;
+        while (getline(file, line)) {
+            if (line.compare(0, 6, "{\"ph\":") != 0) {
+                continue;
+            }
+            if (line.back() == ',') {
+                line.pop_back();
+            }
+            cout << (first ? "\n" : ",\n") << line;
+            first = false;
+        }
+    }
+    cout << "\n],\n\"displayTimeUnit\": \"ns\"}" << endl;
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include "assembler.h"
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include "isa.h"
+
+// Operand layout of each opcode: 'r' fills the next of a/b/c, 'i' fills imm
+struct OpcodeInfo
+{
+	const char* name;
+	const char* operands;
+};
+
+static const OpcodeInfo OPCODES[OP_COUNT] = {
+	{"halt", ""},
+	{"loadi", "ri"},
+	{"mov", "rr"},
+	{"add", "rrr"},
+	{"addi", "rri"},
+	{"sub", "rrr"},
+	{"mul", "rrr"},
+	{"load", "rri"},
+	{"store", "rri"},
+	{"copy", "rrr"},
+	{"jmp", "i"},
+	{"jz", "ri"},
+	{"jnz", "ri"},
+	{"jlt", "rri"},
+	{"call", "i"},
+	{"ret", ""},
+	{"print", "r"},
+	{"ivec", "i"},
+	{"iret", ""}
+};
+
+static std::string trim(const std::string& text)
+{
+	size_t start = text.find_first_not_of(" \t\r");
+	if(start == std::string::npos)
+		return "";
+	size_t end = text.find_last_not_of(" \t\r");
+	return text.substr(start, end - start + 1);
+}
+
+static std::vector<std::string> splitOperands(const std::string& text)
+{
+	std::vector<std::string> operands;
+	std::stringstream stream(text);
+	std::string operand;
+	while(std::getline(stream, operand, ','))
+		operands.push_back(trim(operand));
+	if(operands.size() == 1 && operands[0].empty())
+		operands.clear();
+	return operands;
+}
+
+static bool parseRegister(const std::string& text, uint8_t& reg)
+{
+	if(text == "sp")
+	{
+		reg = SP;
+		return true;
+	}
+	if(text.size() == 2 && text[0] == 'r' && text[1] >= '0' && text[1] < '0' + REGISTER_COUNT)
+	{
+		reg = text[1] - '0';
+		return true;
+	}
+	return false;
+}
+
+static bool parseValue(const std::string& text, const std::map<std::string, uint32_t>& labels, int32_t& value)
+{
+	auto label = labels.find(text);
+	if(label != labels.end())
+	{
+		value = label->second;
+		return true;
+	}
+	char* end;
+	long long number = strtoll(text.c_str(), &end, 0);
+	if(text.empty() || *end != '\0')
+		return false;
+	value = (int32_t)number;
+	return true;
+}
+
+// One source line with its label, mnemonic and operands split out
+struct SourceLine
+{
+	int number;
+	std::string mnemonic;
+	std::vector<std::string> operands;
+};
+
+bool assemble(const std::string& path, std::vector<char>& image, std::string& error)
+{
+	std::ifstream file(path);
+	if(!file.is_open())
+	{
+		error = "unable to open " + path;
+		return false;
+	}
+
+	// First pass: find where every label lands
+	std::map<std::string, uint32_t> labels;
+	std::vector<SourceLine> lines;
+	uint32_t address = 0;
+	std::string text;
+	for(int number = 1; std::getline(file, text); number++)
+	{
+		text = trim(text.substr(0, text.find('#')));
+		size_t colon = text.find(':');
+		if(colon != std::string::npos)
+		{
+			labels[trim(text.substr(0, colon))] = address;
+			text = trim(text.substr(colon + 1));
+		}
+		if(text.empty())
+			continue;
+
+		size_t space = text.find_first_of(" \t");
+		SourceLine line = {number, text.substr(0, space), {}};
+		if(space != std::string::npos)
+			line.operands = splitOperands(text.substr(space + 1));
+
+		if(line.mnemonic == ".word")
+			address += 4 * line.operands.size();
+		else if(line.mnemonic == ".space")
+			address += strtoul(line.operands.empty() ? "0" : line.operands[0].c_str(), NULL, 0);
+		else
+			address += sizeof(Instruction);
+		lines.push_back(line);
+	}
+
+	// Second pass: encode
+	image.clear();
+	for(const SourceLine& line : lines)
+	{
+		std::string where = path + ":" + std::to_string(line.number) + ": ";
+		if(line.mnemonic == ".word")
+		{
+			for(const std::string& operand : line.operands)
+			{
+				int32_t value;
+				if(!parseValue(operand, labels, value))
+				{
+					error = where + "bad value '" + operand + "'";
+					return false;
+				}
+				image.insert(image.end(), (char*)&value, (char*)&value + 4);
+			}
+			continue;
+		}
+		if(line.mnemonic == ".space")
+		{
+			image.resize(image.size() + strtoul(line.operands.empty() ? "0" : line.operands[0].c_str(), NULL, 0));
+			continue;
+		}
+
+		int opcode = 0;
+		while(opcode < OP_COUNT && line.mnemonic != OPCODES[opcode].name)
+			opcode++;
+		if(opcode == OP_COUNT)
+		{
+			error = where + "unknown instruction '" + line.mnemonic + "'";
+			return false;
+		}
+		const char* layout = OPCODES[opcode].operands;
+		if(line.operands.size() != strlen(layout))
+		{
+			error = where + line.mnemonic + " takes " + std::to_string(strlen(layout)) + " operands";
+			return false;
+		}
+
+		Instruction instruction = {(uint8_t)opcode, 0, 0, 0, 0};
+		uint8_t* regs[] = {&instruction.a, &instruction.b, &instruction.c};
+		int nextReg = 0;
+		for(size_t i = 0; i < line.operands.size(); i++)
+		{
+			bool ok = layout[i] == 'r' ? parseRegister(line.operands[i], *regs[nextReg++])
+			                           : parseValue(line.operands[i], labels, instruction.imm);
+			if(!ok)
+			{
+				error = where + "bad operand '" + line.operands[i] + "'";
+				return false;
+			}
+		}
+		image.insert(image.end(), (char*)&instruction, (char*)&instruction + sizeof(instruction));
+	}
+	return true;
+}
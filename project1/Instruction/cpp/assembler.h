@@ -0,0 +1,15 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include <string>
+#include <vector>
+
+// Assembles a program file into the memory image that is loaded at address 0.
+//
+// One instruction per line, operands separated by commas; '#' starts a
+// comment. "name:" defines a label, usable wherever an immediate is.
+// ".word v, ..." places 4-byte values and ".space n" reserves n zero bytes.
+// On failure returns false with error naming the line.
+bool assemble(const std::string& path, std::vector<char>& image, std::string& error);
+
+#endif
@@ -0,0 +1,300 @@
+#include "cache_sim.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdlib.h>
+
+static bool powerOfTwo(uint32_t value)
+{
+	return value != 0 && (value & (value - 1)) == 0;
+}
+
+bool parseCacheConfig(const std::string& text, CacheConfig& config)
+{
+	std::vector<std::string> fields;
+	std::stringstream stream(text);
+	std::string field;
+	while(std::getline(stream, field, ':'))
+		fields.push_back(field);
+	if(fields.size() < 3 || fields.size() > 4)
+		return false;
+
+	config.sets = strtoul(fields[0].c_str(), NULL, 0);
+	config.ways = strtoul(fields[1].c_str(), NULL, 0);
+	config.lineBytes = strtoul(fields[2].c_str(), NULL, 0);
+	config.replacement = REPLACE_LRU;
+	if(fields.size() == 4)
+	{
+		if(fields[3] == "plru")
+			config.replacement = REPLACE_PLRU;
+		else if(fields[3] != "lru")
+			return false;
+	}
+	return powerOfTwo(config.sets) && powerOfTwo(config.ways) && powerOfTwo(config.lineBytes);
+}
+
+CacheLevel::CacheLevel(const CacheConfig& config)
+	: hits(0), misses(0), writebacks(0), geometry(config),
+	  lines(config.sets * config.ways, Line{0, false, false, 0}),
+	  plruBits(config.sets * config.ways, 0), useClock(0)
+{
+}
+
+int CacheLevel::find(uint64_t tag) const
+{
+	int first = (tag % geometry.sets) * geometry.ways;
+	for(int i = first; i < first + (int)geometry.ways; i++)
+	{
+		if(lines[i].valid && lines[i].tag == tag)
+			return i;
+	}
+	return -1;
+}
+
+void CacheLevel::touch(int index)
+{
+	lines[index].lastUse = ++useClock;
+	if(geometry.replacement != REPLACE_PLRU)
+		return;
+
+	// Walk from the root to this way, pointing every node away from it
+	uint8_t* bits = &plruBits[index / geometry.ways * geometry.ways];
+	uint32_t way = index % geometry.ways;
+	uint32_t node = 0;
+	for(uint32_t half = geometry.ways / 2; half > 0; half /= 2)
+	{
+		bool right = way & half;
+		bits[node] = !right;
+		node = 2 * node + 1 + right;
+	}
+}
+
+int CacheLevel::victim(uint64_t tag) const
+{
+	int first = (tag % geometry.sets) * geometry.ways;
+	for(int i = first; i < first + (int)geometry.ways; i++)
+	{
+		if(!lines[i].valid)
+			return i;
+	}
+
+	if(geometry.replacement == REPLACE_PLRU)
+	{
+		// Follow the bits to the way they point at
+		const uint8_t* bits = &plruBits[first];
+		uint32_t way = 0;
+		uint32_t node = 0;
+		for(uint32_t half = geometry.ways / 2; half > 0; half /= 2)
+		{
+			bool right = bits[node];
+			if(right)
+				way |= half;
+			node = 2 * node + 1 + right;
+		}
+		return first + way;
+	}
+
+	int oldest = first;
+	for(int i = first + 1; i < first + (int)geometry.ways; i++)
+	{
+		if(lines[i].lastUse < lines[oldest].lastUse)
+			oldest = i;
+	}
+	return oldest;
+}
+
+CacheHierarchy::CacheHierarchy(MemClient& mem, uint64_t memoryBytes, const std::vector<CacheConfig>& levels,
+                               const CacheConfig& tlb)
+	: mem(mem), memoryBytes(memoryBytes), lineBytes(levels.front().lineBytes),
+	  tlb(tlb), cycles(0), fills(0)
+{
+	for(const CacheConfig& config : levels)
+		this->levels.push_back(CacheLevel(config));
+	data.resize(this->levels.back().slots() * lineBytes);
+}
+
+uint32_t CacheHierarchy::lineLength(uint64_t tag) const
+{
+	// The last line may run past the end of a memory that isn't a whole number of lines
+	return std::min<uint64_t>(lineBytes, memoryBytes - tag * lineBytes);
+}
+
+void CacheHierarchy::evict(size_t level, int index)
+{
+	CacheLevel::Line& line = levels[level].at(index);
+	if(!line.valid)
+		return;
+
+	// Inclusion: the line leaves every level above first, handing its
+	// dirty state down
+	for(size_t above = 0; above < level; above++)
+	{
+		int slot = levels[above].find(line.tag);
+		if(slot != -1)
+			evict(above, slot);
+	}
+
+	if(line.dirty)
+	{
+		levels[level].writebacks++;
+		if(level + 1 == levels.size())
+		{
+			mem.store(line.tag * lineBytes, &data[(size_t)index * lineBytes], lineLength(line.tag));
+			cycles += MEMORY_CYCLES;
+		}
+		else
+		{
+			// The level below holds the line too, so only its dirty bit changes
+			levels[level + 1].at(levels[level + 1].find(line.tag)).dirty = true;
+			cycles += levels[level + 1].config().hitCycles;
+		}
+	}
+	line.valid = false;
+}
+
+char* CacheHierarchy::access(uint32_t addr, bool write)
+{
+	uint64_t page = addr / tlb.config().lineBytes;
+	int entry = tlb.find(page);
+	if(entry != -1)
+		tlb.hits++;
+	else
+	{
+		tlb.misses++;
+		cycles += TLB_MISS_CYCLES;
+		entry = tlb.victim(page);
+		tlb.at(entry) = {page, true, false, 0};
+	}
+	tlb.touch(entry);
+
+	uint64_t tag = addr / lineBytes;
+	size_t hitLevel = levels.size();
+	for(size_t level = 0; level < levels.size(); level++)
+	{
+		cycles += levels[level].config().hitCycles;
+		int index = levels[level].find(tag);
+		if(index != -1)
+		{
+			levels[level].hits++;
+			levels[level].touch(index);
+			hitLevel = level;
+			break;
+		}
+		levels[level].misses++;
+	}
+
+	CacheLevel& last = levels.back();
+	if(hitLevel == levels.size())
+	{
+		int index = last.victim(tag);
+		evict(levels.size() - 1, index);
+		mem.load(tag * lineBytes, &data[(size_t)index * lineBytes], lineLength(tag));
+		cycles += MEMORY_CYCLES;
+		fills++;
+		last.at(index) = {tag, true, false, 0};
+		last.touch(index);
+		hitLevel = levels.size() - 1;
+	}
+
+	// Bring the line up to L1
+	for(size_t level = hitLevel; level-- > 0;)
+	{
+		int index = levels[level].victim(tag);
+		evict(level, index);
+		levels[level].at(index) = {tag, true, false, 0};
+		levels[level].touch(index);
+	}
+
+	int index = last.find(tag);
+	if(write)
+	{
+		levels.front().at(levels.front().find(tag)).dirty = true;
+		last.at(index).dirty = true;
+	}
+	return &data[(size_t)index * lineBytes + addr % lineBytes];
+}
+
+void CacheHierarchy::read(uint32_t addr, void* buffer, uint32_t length)
+{
+	if(addr + (uint64_t)length > memoryBytes)
+	{
+		mem.load(addr, buffer, length);   // mem reports the bad access
+		return;
+	}
+	char* out = (char*)buffer;
+	while(length > 0)
+	{
+		uint32_t piece = std::min(length, lineBytes - addr % lineBytes);
+		std::copy_n(access(addr, false), piece, out);
+		addr += piece;
+		out += piece;
+		length -= piece;
+	}
+}
+
+void CacheHierarchy::write(uint32_t addr, const void* buffer, uint32_t length)
+{
+	if(addr + (uint64_t)length > memoryBytes)
+	{
+		mem.store(addr, buffer, length);
+		return;
+	}
+	const char* in = (const char*)buffer;
+	while(length > 0)
+	{
+		uint32_t piece = std::min(length, lineBytes - addr % lineBytes);
+		std::copy_n(in, piece, access(addr, true));
+		addr += piece;
+		in += piece;
+		length -= piece;
+	}
+}
+
+void CacheHierarchy::copy(uint32_t dst, uint32_t src, uint32_t length)
+{
+	// Goes through the cache like the loads and stores it stands for.
+	// Copying up over an overlap has to start from the end.
+	char buffer[4096];
+	bool backwards = dst > src && dst < src + (uint64_t)length;
+	for(uint64_t done = 0; done < length; done += sizeof(buffer))
+	{
+		uint32_t piece = std::min<uint64_t>(length - done, sizeof(buffer));
+		uint32_t offset = backwards ? length - done - piece : done;
+		read(src + offset, buffer, piece);
+		write(dst + offset, buffer, piece);
+	}
+}
+
+void CacheHierarchy::flush()
+{
+	CacheLevel& last = levels.back();
+	for(size_t index = 0; index < last.slots(); index++)
+	{
+		if(last.at(index).valid && last.at(index).dirty)
+		{
+			mem.store(last.at(index).tag * lineBytes, &data[index * lineBytes], lineLength(last.at(index).tag));
+			last.at(index).dirty = false;
+		}
+	}
+}
+
+void CacheHierarchy::report(std::ostream& out, uint64_t instructions) const
+{
+	auto line = [&](const std::string& name, const CacheLevel& level)
+	{
+		uint64_t accesses = level.hits + level.misses;
+		out << std::left << std::setw(5) << name << std::right
+		    << " hits " << std::setw(10) << level.hits
+		    << "  misses " << std::setw(9) << level.misses
+		    << "  hit rate " << std::fixed << std::setprecision(2) << std::setw(6)
+		    << (accesses ? 100.0 * level.hits / accesses : 0) << "%"
+		    << "  writebacks " << level.writebacks << std::endl;
+	};
+	for(size_t level = 0; level < levels.size(); level++)
+		line("L" + std::to_string(level + 1), levels[level]);
+	line("TLB", tlb);
+	out << "memory: " << fills << " line fills" << std::endl;
+	out << "simulated cycles: " << cycles << " (" << std::setprecision(2)
+	    << (instructions ? (double)cycles / instructions : 0) << " per instruction)" << std::endl;
+}
@@ -0,0 +1,112 @@
+#ifndef CACHE_SIM_H
+#define CACHE_SIM_H
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "mem_client.h"
+
+enum Replacement
+{
+	REPLACE_LRU,
+	REPLACE_PLRU    // Tree pseudo-LRU; needs a power-of-two number of ways
+};
+
+// Geometry and hit cost of one cache level. The TLB uses the same
+// structure with a page as its line.
+struct CacheConfig
+{
+	uint32_t sets;
+	uint32_t ways;
+	uint32_t lineBytes;
+	Replacement replacement;
+	uint32_t hitCycles;
+};
+
+// Defaults: 32 KB L1, 256 KB L2, 64-entry TLB of 4 KB pages
+const CacheConfig DEFAULT_L1 = {64, 8, 64, REPLACE_LRU, 4};
+const CacheConfig DEFAULT_L2 = {512, 8, 64, REPLACE_LRU, 12};
+const CacheConfig DEFAULT_TLB = {16, 4, 4096, REPLACE_LRU, 0};
+
+// Simulated cost of going to mem for a line, and of a page walk
+const uint32_t MEMORY_CYCLES = 200;
+const uint32_t TLB_MISS_CYCLES = 30;
+
+// Parses "sets:ways:line[:lru|:plru]", keeping config's hit cost.
+// Sizes must be powers of two.
+bool parseCacheConfig(const std::string& text, CacheConfig& config);
+
+// Tags, dirty bits and replacement state of one set-associative level
+class CacheLevel
+{
+public:
+	struct Line
+	{
+		uint64_t tag;      // Line number (address / line size)
+		bool valid;
+		bool dirty;
+		uint64_t lastUse;  // For LRU
+	};
+
+	explicit CacheLevel(const CacheConfig& config);
+
+	// Index of the slot holding the line, or -1. Doesn't count as a use.
+	int find(uint64_t tag) const;
+	// Marks a slot most recently used
+	void touch(int index);
+	// Slot the line would be placed in: an invalid one if there is one
+	int victim(uint64_t tag) const;
+
+	Line& at(int index) { return lines[index]; }
+	const CacheConfig& config() const { return geometry; }
+	size_t slots() const { return lines.size(); }
+
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t writebacks;
+
+private:
+	CacheConfig geometry;
+	std::vector<Line> lines;       // sets * ways, a set's ways together
+	std::vector<uint8_t> plruBits; // ways - 1 tree bits per set
+	uint64_t useClock;
+};
+
+// An inclusive, write-back cache hierarchy in front of mem. Line data is
+// held by the last level, so hits are served in cpu without a pipe round
+// trip: mem only sees line fills and write-backs of dirty lines. Every
+// level uses the same line size.
+class CacheHierarchy
+{
+public:
+	CacheHierarchy(MemClient& mem, uint64_t memoryBytes, const std::vector<CacheConfig>& levels,
+	               const CacheConfig& tlb);
+
+	void read(uint32_t addr, void* buffer, uint32_t length);
+	void write(uint32_t addr, const void* buffer, uint32_t length);
+	void copy(uint32_t dst, uint32_t src, uint32_t length);
+
+	// Writes every dirty line back to mem
+	void flush();
+
+	void report(std::ostream& out, uint64_t instructions) const;
+
+private:
+	// Line data for addr, after bringing the line into every level
+	char* access(uint32_t addr, bool write);
+	void evict(size_t level, int index);
+	uint32_t lineLength(uint64_t tag) const;
+
+	MemClient& mem;
+	uint64_t memoryBytes;
+	uint32_t lineBytes;
+	std::vector<CacheLevel> levels;
+	CacheLevel tlb;
+	std::vector<char> data;    // One line per slot of the last level
+
+	uint64_t cycles;
+	uint64_t fills;
+};
+
+#endif
@@ -1,73 +1,135 @@
 #include <iostream>
-#include <sys/wait.h>
+#include <chrono>
+#include <string>
+#include <vector>
 #include <stdlib.h>
-#include <unistd.h>               /* UNIX and POSIX constants and functions (fork, pipe) */
+#include "assembler.h"
+#include "cache_sim.h"
+#include "emulator.h"
+#include "mem_client.h"
 
 int main(int argc, const char** argv)
 {
+	uint64_t memoryBytes = MEM_DEFAULT_BYTES;
+	bool shared = false;
+	uint64_t timer = 0;
+	std::string dispatch;
 
-	// To store pipe identifiers
-	// p1[0] - read from pipe
-	// p1[1] - write to pipe
-    int p1[2],p2[2];
-	pid_t child; // To store the process id
-
-	if(pipe(p1) == -1)
+	// The cache is off unless --cache or one of the levels is given
+	bool cached = false;
+	bool useL2 = true;
+	CacheConfig l1 = DEFAULT_L1, l2 = DEFAULT_L2, tlb = DEFAULT_TLB;
+	const char* program = NULL;
+	for(int i = 1; i < argc; i++)
 	{
-		std::cerr << "Unable to create first pipe" << std::endl;
-		exit(-1);
+		std::string option = argv[i];
+		if(option == "--mem-bytes" && i + 1 < argc)
+			memoryBytes = strtoull(argv[++i], NULL, 0);
+		else if(option == "--shared")
+			shared = true;
+		else if(option == "--timer" && i + 1 < argc)
+			timer = strtoull(argv[++i], NULL, 0);
+		else if(option == "--dispatch" && i + 1 < argc)
+			dispatch = argv[++i];
+		else if(option == "--cache")
+			cached = true;
+		else if((option == "--l1" || option == "--l2" || option == "--tlb") && i + 1 < argc)
+		{
+			cached = true;
+			std::string spec = argv[++i];
+			CacheConfig& config = option == "--l1" ? l1 : option == "--l2" ? l2 : tlb;
+			if(option == "--l2" && spec == "none")
+				useL2 = false;
+			else if(!parseCacheConfig(spec, config))
+			{
+				std::cerr << "Bad " << option << " (want sets:ways:line[:lru|:plru], powers of two): " << spec << std::endl;
+				return 1;
+			}
+		}
+		else if(program == NULL && option[0] != '-')
+			program = argv[i];
+		else
+		{
+			std::cerr << "Unknown option: " << option << std::endl;
+			return 1;
+		}
 	}
-
-	if(pipe(p2) == -1)
+	if(program == NULL)
 	{
-		std::cerr << "Unable to create second pipe" << std::endl;
-		exit(-1);
+		std::cerr << "Usage: " << argv[0] << " [--mem-bytes <n>] [--shared] [--timer <n>]"
+		          << " [--dispatch fetch|switch|threaded] [--cache]"
+		          << " [--l1 <sets:ways:line[:plru]>] [--l2 <...>|none] [--tlb <sets:ways:page>] <program.s>" << std::endl;
+		return 1;
 	}
-
-	child = fork();
-
-    if(child == -1)
+	if(memoryBytes == 0 || memoryBytes > MEM_MAX_BYTES)
 	{
-		std::cerr << "Error forking" << std::endl;
-		exit(-1);
+		std::cerr << "Memory must be between 1 and " << MEM_MAX_BYTES << " bytes" << std::endl;
+		return 1;
 	}
 
-	if(child == 0)
+	std::vector<char> image;
+	std::string error;
+	if(!assemble(program, image, error))
 	{
-		//I am the child process
-		close(p1[1]); // p1 is for reading
-		close(p2[0]); // p2 is for writing
-		dup2(p1[0], 0); //map pipe to stdin
-		dup2(p2[1], 1); //map pipe to stdout
-
-		char *args[] = {"./mem",NULL};
-		execvp(args[0],args); //replace this program with the mem program
+		std::cerr << error << std::endl;
+		return 1;
 	}
+	if(image.size() > memoryBytes)
+	{
+		std::cerr << program << " needs " << image.size() << " bytes of memory" << std::endl;
+		return 1;
+	}
+
+	// The cache sees every fetch only when instructions are fetched each time
+	if(dispatch.empty())
+		dispatch = cached ? "fetch" : "threaded";
+	Dispatch mode;
+	if(dispatch == "fetch")
+		mode = DISPATCH_FETCH;
+	else if(dispatch == "switch")
+		mode = DISPATCH_SWITCH;
+	else if(dispatch == "threaded")
+		mode = DISPATCH_THREADED;
 	else
 	{
-		//I am the parent
-		close(p1[0]);
-		close(p2[1]);
+		std::cerr << "Unknown dispatch: " << dispatch << std::endl;
+		return 1;
+	}
 
-		char tmp;
+	std::vector<CacheConfig> levels = {l1};
+	if(useL2)
+		levels.push_back(l2);
+	if(cached && useL2 && l2.lineBytes != l1.lineBytes)
+	{
+		std::cerr << "L1 and L2 must use the same line size" << std::endl;
+		return 1;
+	}
 
-		for(int i=10; i>0; i--)
-		{
-            tmp = 1; //write command
-			write(p1[1], &tmp, 1);
-			write(p1[1], (char*)&i, sizeof(int));
-			std::cout << "Set to ";
-			tmp = 0; //Read Command
-			write(p1[1], &tmp, 1);
-			int val;
-			read(p2[0], (char*)&val, sizeof(int));
-			std::cout << val << std::endl;
+	MemClient mem;
+	mem.start("./mem", memoryBytes, shared);
+	mem.store(0, image.data(), image.size());
 
-		}
+	CacheHierarchy cache(mem, memoryBytes, levels, tlb);
+	Cpu cpu(mem, memoryBytes, cached ? &cache : NULL);
+	cpu.setTimer(timer);
+	cpu.setProgramSize(image.size());
+	auto start = std::chrono::steady_clock::now();
+	bool ok = cpu.run(0, mode);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if(cached)
+		cache.flush();
+	mem.halt();
 
-        tmp = 2; // Halt Mem Command
-		write(p1[1], &tmp, 1);
-        wait(NULL);
-	}
-	return 0;
+	std::cout.flush();
+	if(!ok)
+		std::cerr << cpu.fault() << std::endl;
+	std::cerr << "cpu: " << cpu.executed() << " instructions in " << seconds << " s, "
+	          << (uint64_t)(cpu.executed() / seconds) << " instructions/sec" << std::endl;
+	if(timer > 0)
+		std::cerr << "timer: " << cpu.interrupts() << " interrupts" << std::endl;
+	std::cerr << "pipe: " << mem.commands() << " commands, " << mem.bytesSent() << " bytes sent, "
+	          << mem.bytesReceived() << " bytes received" << std::endl;
+	if(cached)
+		cache.report(std::cerr, cpu.executed());
+	return ok ? 0 : 1;
 }
@@ -0,0 +1,77 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "assembler.h"
+#include "emulator.h"
+#include "mem_client.h"
+
+// Emulated MIPS of each benchmark program under each dispatch strategy.
+// Memory is shared, so the numbers measure the interpreter, not the pipe.
+int main(int argc, const char** argv)
+{
+	std::vector<std::string> programs = {"programs/bench/loop.s", "programs/bench/memcopy.s", "programs/bench/calls.s"};
+	if(argc > 1)
+		programs.assign(argv + 1, argv + argc);
+
+	struct Strategy
+	{
+		const char* name;
+		Dispatch dispatch;
+	};
+	Strategy strategies[] = {
+		{"fetch", DISPATCH_FETCH},
+		{"switch", DISPATCH_SWITCH},
+		{HAVE_COMPUTED_GOTO ? "threaded" : "threaded (switch)", DISPATCH_THREADED}
+	};
+
+	std::cout << std::left << std::setw(28) << "program";
+	for(const Strategy& strategy : strategies)
+		std::cout << std::right << std::setw(12) << strategy.name;
+	std::cout << "   (MIPS)" << std::endl;
+
+	for(const std::string& program : programs)
+	{
+		std::vector<char> image;
+		std::string error;
+		if(!assemble(program, image, error))
+		{
+			std::cerr << error << std::endl;
+			return 1;
+		}
+
+		std::string name = program.substr(program.rfind('/') + 1);
+		std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(1);
+		std::string expected;
+		for(const Strategy& strategy : strategies)
+		{
+			MemClient mem;
+			mem.start("./mem", MEM_DEFAULT_BYTES, true);
+			mem.store(0, image.data(), image.size());
+
+			std::ostringstream output;
+			Cpu cpu(mem, MEM_DEFAULT_BYTES);
+			cpu.setProgramSize(image.size());
+			cpu.setOutput(output);
+			auto start = std::chrono::steady_clock::now();
+			bool ok = cpu.run(0, strategy.dispatch);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			mem.halt();
+
+			// Every strategy has to compute the same thing
+			if(expected.empty())
+				expected = output.str();
+			if(!ok || output.str() != expected)
+			{
+				std::cerr << std::endl << program << ": " << strategy.name << " went wrong: "
+				          << (ok ? "different output" : cpu.fault()) << std::endl;
+				return 1;
+			}
+			std::cout << std::setw(12) << cpu.executed() / seconds / 1e6 << std::flush;
+		}
+		std::cout << std::endl;
+	}
+	return 0;
+}
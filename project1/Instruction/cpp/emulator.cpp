@@ -0,0 +1,234 @@
+#include "emulator.h"
+
+#include <algorithm>
+#include <iostream>
+
+Cpu::Cpu(MemClient& mem, uint64_t memoryBytes, CacheHierarchy* cache)
+	: mem(mem), cache(cache), pc(0), instructions(0), programBytes(0), output(&std::cout),
+	  handlerTable(NULL), timerCountdown(INT64_MAX), timerPeriod(0),
+	  handler(0), handlerSet(false), inHandler(false), tickPending(false), interruptCount(0)
+{
+	for(int i = 0; i < REGISTER_COUNT; i++)
+		regs[i] = 0;
+	// The stack grows down from the top; 4 GB wraps to 0, which is still the top
+	regs[SP] = (int32_t)(uint32_t)memoryBytes;
+}
+
+bool Cpu::stop(const std::string& message)
+{
+	faultMessage = "fault at " + std::to_string(pc) + ": " + message;
+	return false;
+}
+
+void Cpu::setTimer(uint64_t period)
+{
+	timerPeriod = period;
+	// Off is a countdown that never runs out
+	timerCountdown = period > 0 ? (int64_t)period : INT64_MAX;
+}
+
+int64_t Cpu::timerExpired()
+{
+	if(!handlerSet)
+		return timerPeriod;
+	if(inHandler)
+	{
+		tickPending = true;
+		return timerPeriod;
+	}
+
+	interruptCount++;
+	inHandler = true;
+	regs[SP] -= 4;
+	storeWord(regs[SP], pc);
+	pc = handler;
+	return timerPeriod;
+}
+
+const char* Cpu::invalid(const Instruction& in)
+{
+	if(in.opcode >= OP_COUNT)
+		return "bad opcode";
+	if(in.a >= REGISTER_COUNT || in.b >= REGISTER_COUNT || in.c >= REGISTER_COUNT)
+		return "bad register";
+	return NULL;
+}
+
+void Cpu::decode(Decoded& slot, uint32_t addr)
+{
+	Instruction in;
+	read(addr, &in, sizeof(in));
+	slot.opcode = invalid(in) ? OP_BAD : in.opcode;
+	slot.a = in.a;
+	slot.b = in.b;
+	slot.c = in.c;
+	slot.imm = in.imm;
+
+	// Jumps go straight to a slot
+	switch(slot.opcode)
+	{
+		case OP_JMP:
+		case OP_JZ:
+		case OP_JNZ:
+		case OP_JLT:
+		case OP_CALL:
+			if((uint32_t)in.imm % sizeof(Instruction) != 0 || (uint32_t)in.imm / sizeof(Instruction) >= decoded.size())
+				slot.imm = -1;
+			else
+				slot.imm = (uint32_t)in.imm / sizeof(Instruction);
+			break;
+	}
+	slot.handler = handlerTable != NULL ? handlerTable[slot.opcode] : NULL;
+}
+
+void Cpu::invalidateSlots(uint32_t addr, uint32_t length)
+{
+	uint64_t last = std::min<uint64_t>(((uint64_t)addr + length - 1) / sizeof(Instruction), decoded.size() - 1);
+	for(uint64_t i = addr / sizeof(Instruction); i <= last && length > 0; i++)
+	{
+		decoded[i].opcode = OP_DECODE;
+		decoded[i].handler = handlerTable != NULL ? handlerTable[OP_DECODE] : NULL;
+	}
+}
+
+bool Cpu::run(uint32_t entry, Dispatch dispatch)
+{
+	if(dispatch == DISPATCH_FETCH || programBytes < sizeof(Instruction))
+		return runFetch(entry);
+
+	decoded.assign(programBytes / sizeof(Instruction), Decoded{NULL, OP_DECODE, 0, 0, 0, 0});
+	bool ok;
+#if HAVE_COMPUTED_GOTO
+	if(dispatch == DISPATCH_THREADED)
+		ok = runThreaded(entry);
+	else
+#endif
+		ok = runSwitch(entry);
+	decoded.clear();
+	handlerTable = NULL;
+	return ok;
+}
+
+// The predecoded loop, built once with each kind of dispatch
+#define LOOP_NAME runSwitch
+#define THREADED 0
+#include "emulator_loop.h"
+#undef LOOP_NAME
+#undef THREADED
+
+#if HAVE_COMPUTED_GOTO
+#define LOOP_NAME runThreaded
+#define THREADED 1
+#include "emulator_loop.h"
+#undef LOOP_NAME
+#undef THREADED
+#endif
+
+bool Cpu::runFetch(uint32_t entry)
+{
+	pc = entry;
+	// The countdown is kept in a local so it can live in a register, and it
+	// doubles as the instruction counter: what it has counted down since its
+	// last reload is added to instructions on each reload and on the way
+	// out. The timer then costs the loop nothing it didn't already pay.
+	int64_t countdown = timerCountdown;
+	int64_t reload = countdown;
+	while(true)
+	{
+		if(__builtin_expect(--countdown == 0, 0))
+		{
+			instructions += reload;
+			countdown = reload = timerExpired();
+		}
+
+		Instruction in;
+		read(pc, &in, sizeof(in));
+		if(invalid(in) != NULL)
+		{
+			instructions += reload - countdown - 1;
+			return stop(invalid(in));
+		}
+
+		uint32_t next = pc + sizeof(Instruction);
+		int32_t& a = regs[in.a];
+		int32_t b = regs[in.b];
+		int32_t c = regs[in.c];
+		switch(in.opcode)
+		{
+			case OP_HALT:
+				instructions += reload - countdown;
+				return true;
+			case OP_LOADI:
+				a = in.imm;
+				break;
+			case OP_MOV:
+				a = b;
+				break;
+			case OP_ADD:
+				a = (int32_t)((uint32_t)b + (uint32_t)c);
+				break;
+			case OP_ADDI:
+				a = (int32_t)((uint32_t)b + (uint32_t)in.imm);
+				break;
+			case OP_SUB:
+				a = (int32_t)((uint32_t)b - (uint32_t)c);
+				break;
+			case OP_MUL:
+				a = (int32_t)((uint32_t)b * (uint32_t)c);
+				break;
+			case OP_LOAD:
+				a = loadWord((uint32_t)b + in.imm);
+				break;
+			case OP_STORE:
+				storeWord((uint32_t)b + in.imm, a);
+				break;
+			case OP_COPY:
+				copy(a, b, c);
+				break;
+			case OP_JMP:
+				next = in.imm;
+				break;
+			case OP_JZ:
+				if(a == 0)
+					next = in.imm;
+				break;
+			case OP_JNZ:
+				if(a != 0)
+					next = in.imm;
+				break;
+			case OP_JLT:
+				if(a < b)
+					next = in.imm;
+				break;
+			case OP_CALL:
+				regs[SP] -= 4;
+				storeWord(regs[SP], next);
+				next = in.imm;
+				break;
+			case OP_RET:
+				next = loadWord(regs[SP]);
+				regs[SP] += 4;
+				break;
+			case OP_PRINT:
+				*output << a << '\n';
+				break;
+			case OP_IVEC:
+				handler = in.imm;
+				handlerSet = true;
+				break;
+			case OP_IRET:
+				next = loadWord(regs[SP]);
+				regs[SP] += 4;
+				inHandler = false;
+				// A tick held while the handler ran is taken straight away
+				if(tickPending)
+				{
+					tickPending = false;
+					instructions += reload - countdown;
+					countdown = reload = 1;
+				}
+				break;
+		}
+		pc = next;
+	}
+}
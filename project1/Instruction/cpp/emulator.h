@@ -0,0 +1,145 @@
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "cache_sim.h"
+#include "isa.h"
+#include "mem_client.h"
+
+// How run() executes instructions
+enum Dispatch
+{
+	DISPATCH_FETCH,     // Fetch and decode every instruction from memory
+	DISPATCH_SWITCH,    // Predecoded instructions, switch dispatch
+	DISPATCH_THREADED   // Predecoded instructions, computed-goto dispatch
+};
+
+#if defined(__GNUC__)
+#define HAVE_COMPUTED_GOTO 1
+#else
+#define HAVE_COMPUTED_GOTO 0    // DISPATCH_THREADED runs the switch loop
+#endif
+
+// Interpreter for the machine in isa.h. Instruction fetches and
+// loads/stores go to the mem process, or through the cache when given one.
+//
+// The predecoded dispatches decode each instruction of the program the
+// first time it runs and keep the result, so later runs skip the fetch.
+// A store into the program marks the instructions it touches for decoding
+// again. Jumps must stay inside the program and on instruction boundaries.
+class Cpu
+{
+public:
+	Cpu(MemClient& mem, uint64_t memoryBytes, CacheHierarchy* cache = NULL);
+
+	// The program occupies [0, bytes); only that range is predecoded
+	void setProgramSize(uint32_t bytes) { programBytes = bytes; }
+	// Where print writes; stdout by default
+	void setOutput(std::ostream& out) { output = &out; }
+
+	// Interrupts every period instructions once the program has set a
+	// handler with ivec; 0 turns the timer off
+	void setTimer(uint64_t period);
+
+	// Runs from entry until halt; false if the program faulted
+	bool run(uint32_t entry, Dispatch dispatch = DISPATCH_THREADED);
+
+	uint64_t executed() const { return instructions; }
+	uint64_t interrupts() const { return interruptCount; }
+	const std::string& fault() const { return faultMessage; }
+
+private:
+	// Dispatch-only opcodes: not decoded yet, and a fault found by decoding
+	enum { OP_DECODE = OP_COUNT, OP_BAD, DISPATCH_OPCODES };
+
+	// A predecoded instruction. Jump targets are slot numbers, or -1 when
+	// they aren't a valid target.
+	struct Decoded
+	{
+		const void* handler;   // Computed-goto target for the opcode
+		uint8_t opcode;
+		uint8_t a, b, c;
+		int32_t imm;
+	};
+
+	bool runFetch(uint32_t entry);
+	bool runSwitch(uint32_t entry);
+#if HAVE_COMPUTED_GOTO
+	bool runThreaded(uint32_t entry);
+#endif
+
+	// Why an instruction can't run, or NULL
+	static const char* invalid(const Instruction& in);
+	void decode(Decoded& slot, uint32_t addr);
+	void invalidate(uint32_t addr, uint32_t length)
+	{
+		if(addr < decoded.size() * sizeof(Instruction))
+			invalidateSlots(addr, length);
+	}
+	void invalidateSlots(uint32_t addr, uint32_t length);
+
+	bool stop(const std::string& message);
+	// Takes the interrupt if it can; returns the next countdown
+	int64_t timerExpired();
+
+	void read(uint32_t addr, void* buffer, uint32_t length)
+	{
+		if(cache != NULL)
+			cache->read(addr, buffer, length);
+		else
+			mem.load(addr, buffer, length);
+	}
+
+	int loadWord(uint32_t addr)
+	{
+		if(cache == NULL)
+			return mem.read(addr);
+		int value;
+		cache->read(addr, &value, sizeof(value));
+		return value;
+	}
+
+	void storeWord(uint32_t addr, int value)
+	{
+		if(cache != NULL)
+			cache->write(addr, &value, sizeof(value));
+		else
+			mem.write(addr, value);
+		invalidate(addr, sizeof(value));
+	}
+
+	void copy(uint32_t dst, uint32_t src, uint32_t length)
+	{
+		if(cache != NULL)
+			cache->copy(dst, src, length);
+		else
+			mem.copy(dst, src, length);
+		invalidate(dst, length);
+	}
+
+	MemClient& mem;
+	CacheHierarchy* cache;
+	int32_t regs[REGISTER_COUNT];
+	uint32_t pc;
+	uint64_t instructions;
+	uint32_t programBytes;
+	std::ostream* output;
+
+	std::vector<Decoded> decoded;       // One slot per instruction of the program
+	const void* const* handlerTable;    // Labels of the running threaded loop, or NULL
+
+	// Instructions until the first tick; run() counts down a copy of it
+	int64_t timerCountdown;
+	uint64_t timerPeriod;
+	uint32_t handler;
+	bool handlerSet;
+	bool inHandler;
+	bool tickPending;
+	uint64_t interruptCount;
+	std::string faultMessage;
+};
+
+#endif
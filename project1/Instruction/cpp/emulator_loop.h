@@ -0,0 +1,206 @@
+// The predecoded interpreter loop. emulator.cpp includes this twice, with
+// LOOP_NAME and THREADED defined: once for switch dispatch and once for
+// computed gotos, so both run the same instruction bodies.
+//
+// DISPATCH() counts the instruction about to run against the timer, then
+// jumps to its body. In the threaded loop every body ends in its own
+// indirect jump, which the branch predictor learns per instruction.
+
+#if THREADED
+#define TARGET(op) target_##op:
+#define JUMP_TO_HANDLER() goto *ip->handler
+#else
+#define TARGET(op) case op:
+#define JUMP_TO_HANDLER() goto dispatch
+#endif
+
+#define DISPATCH() do { if(__builtin_expect(--countdown == 0, 0)) goto timer; JUMP_TO_HANDLER(); } while(0)
+#define NEXT() do { ip++; DISPATCH(); } while(0)
+#define SLOT_PC() ((uint32_t)(ip - code) * (uint32_t)sizeof(Instruction))
+
+// Moves to the instruction at a dynamic address, if it's a valid target
+#define GO_TO(addr) do { \
+		uint32_t destination = (addr); \
+		if(destination % sizeof(Instruction) != 0 || destination / sizeof(Instruction) >= decoded.size()) \
+		{ \
+			pc = destination; \
+			goto bad_target; \
+		} \
+		ip = code + destination / sizeof(Instruction); \
+	} while(0)
+
+bool Cpu::LOOP_NAME(uint32_t entry)
+{
+#if THREADED
+	static const void* const labels[DISPATCH_OPCODES] = {
+		&&target_OP_HALT, &&target_OP_LOADI, &&target_OP_MOV, &&target_OP_ADD,
+		&&target_OP_ADDI, &&target_OP_SUB, &&target_OP_MUL, &&target_OP_LOAD,
+		&&target_OP_STORE, &&target_OP_COPY, &&target_OP_JMP, &&target_OP_JZ,
+		&&target_OP_JNZ, &&target_OP_JLT, &&target_OP_CALL, &&target_OP_RET,
+		&&target_OP_PRINT, &&target_OP_IVEC, &&target_OP_IRET,
+		&&target_OP_DECODE, &&target_OP_BAD
+	};
+	static_assert(DISPATCH_OPCODES == 21, "labels must list every opcode in order");
+	handlerTable = labels;
+	for(Decoded& slot : decoded)
+		slot.handler = labels[slot.opcode];
+#else
+	handlerTable = NULL;
+#endif
+
+	// See runFetch() for how the countdown also counts instructions
+	int64_t countdown = timerCountdown;
+	int64_t reload = countdown;
+	int32_t* r = regs;
+	Decoded* code = decoded.data();
+	Decoded* ip;
+	GO_TO(entry);
+	DISPATCH();
+
+#if !THREADED
+dispatch:
+	switch(ip->opcode)
+	{
+#endif
+	TARGET(OP_HALT)
+		instructions += reload - countdown;
+		return true;
+	TARGET(OP_LOADI)
+		r[ip->a] = ip->imm;
+		NEXT();
+	TARGET(OP_MOV)
+		r[ip->a] = r[ip->b];
+		NEXT();
+	TARGET(OP_ADD)
+		r[ip->a] = (int32_t)((uint32_t)r[ip->b] + (uint32_t)r[ip->c]);
+		NEXT();
+	TARGET(OP_ADDI)
+		r[ip->a] = (int32_t)((uint32_t)r[ip->b] + (uint32_t)ip->imm);
+		NEXT();
+	TARGET(OP_SUB)
+		r[ip->a] = (int32_t)((uint32_t)r[ip->b] - (uint32_t)r[ip->c]);
+		NEXT();
+	TARGET(OP_MUL)
+		r[ip->a] = (int32_t)((uint32_t)r[ip->b] * (uint32_t)r[ip->c]);
+		NEXT();
+	TARGET(OP_LOAD)
+		r[ip->a] = loadWord((uint32_t)r[ip->b] + ip->imm);
+		NEXT();
+	TARGET(OP_STORE)
+		// May overwrite code, including this slot, so ip moves on by address
+		pc = SLOT_PC() + sizeof(Instruction);
+		storeWord((uint32_t)r[ip->b] + ip->imm, r[ip->a]);
+		ip = code + pc / sizeof(Instruction);
+		if(pc / sizeof(Instruction) >= decoded.size())
+			goto bad_target;
+		DISPATCH();
+	TARGET(OP_COPY)
+		pc = SLOT_PC() + sizeof(Instruction);
+		copy(r[ip->a], r[ip->b], r[ip->c]);
+		ip = code + pc / sizeof(Instruction);
+		if(pc / sizeof(Instruction) >= decoded.size())
+			goto bad_target;
+		DISPATCH();
+	TARGET(OP_JMP)
+		if(ip->imm < 0)
+			goto bad_jump;
+		ip = code + ip->imm;
+		DISPATCH();
+	TARGET(OP_JZ)
+		if(r[ip->a] != 0)
+			NEXT();
+		if(ip->imm < 0)
+			goto bad_jump;
+		ip = code + ip->imm;
+		DISPATCH();
+	TARGET(OP_JNZ)
+		if(r[ip->a] == 0)
+			NEXT();
+		if(ip->imm < 0)
+			goto bad_jump;
+		ip = code + ip->imm;
+		DISPATCH();
+	TARGET(OP_JLT)
+		if(r[ip->a] >= r[ip->b])
+			NEXT();
+		if(ip->imm < 0)
+			goto bad_jump;
+		ip = code + ip->imm;
+		DISPATCH();
+	TARGET(OP_CALL)
+	{
+		if(ip->imm < 0)
+			goto bad_jump;
+		int32_t target = ip->imm;
+		r[SP] -= 4;
+		storeWord(r[SP], SLOT_PC() + sizeof(Instruction));
+		ip = code + target;
+		DISPATCH();
+	}
+	TARGET(OP_RET)
+	{
+		uint32_t target = loadWord(r[SP]);
+		r[SP] += 4;
+		GO_TO(target);
+		DISPATCH();
+	}
+	TARGET(OP_PRINT)
+		*output << r[ip->a] << '\n';
+		NEXT();
+	TARGET(OP_IVEC)
+		handler = ip->imm;
+		handlerSet = true;
+		NEXT();
+	TARGET(OP_IRET)
+	{
+		uint32_t target = loadWord(r[SP]);
+		r[SP] += 4;
+		inHandler = false;
+		GO_TO(target);
+		if(tickPending)
+		{
+			tickPending = false;
+			instructions += reload - countdown;
+			countdown = reload = 1;
+		}
+		DISPATCH();
+	}
+	TARGET(OP_DECODE)
+		// Already counted; decode and run it
+		decode(*ip, SLOT_PC());
+		JUMP_TO_HANDLER();
+	TARGET(OP_BAD)
+	{
+		pc = SLOT_PC();
+		Instruction in;
+		read(pc, &in, sizeof(in));
+		instructions += reload - countdown - 1;
+		return stop(invalid(in));
+	}
+#if !THREADED
+	}
+#endif
+
+timer:
+	pc = SLOT_PC();
+	instructions += reload;
+	countdown = reload = timerExpired();
+	GO_TO(pc);
+	JUMP_TO_HANDLER();
+
+bad_jump:
+	pc = SLOT_PC();
+	instructions += reload - countdown - 1;
+	return stop("jump outside the program");
+
+bad_target:
+	instructions += reload - countdown;
+	return stop("pc outside the program");
+}
+
+#undef TARGET
+#undef JUMP_TO_HANDLER
+#undef DISPATCH
+#undef NEXT
+#undef SLOT_PC
+#undef GO_TO
@@ -0,0 +1,69 @@
+#ifndef ISA_H
+#define ISA_H
+
+#include <stdint.h>
+
+// The emulated machine has eight 32-bit registers r0-r7 (r7 is also the
+// stack pointer, starting at the top of memory), a program counter and
+// fixed 8-byte instructions. Programs are loaded at address 0.
+//
+//   halt
+//   loadi rA, imm        rA = imm
+//   mov   rA, rB         rA = rB
+//   add   rA, rB, rC     rA = rB + rC
+//   addi  rA, rB, imm    rA = rB + imm
+//   sub   rA, rB, rC     rA = rB - rC
+//   mul   rA, rB, rC     rA = rB * rC
+//   load  rA, rB, imm    rA = the int at address rB + imm
+//   store rA, rB, imm    the int at address rB + imm = rA
+//   copy  rA, rB, rC     copy rC bytes from address rB to address rA
+//   jmp   imm
+//   jz    rA, imm        jump if rA == 0
+//   jnz   rA, imm        jump if rA != 0
+//   jlt   rA, rB, imm    jump if rA < rB
+//   call  imm            push the return address and jump
+//   ret                  pop the return address and jump to it
+//   print rA             write rA in decimal on its own line
+//   ivec  imm            set the timer interrupt handler's address
+//   iret                 return from the timer interrupt handler
+//
+// When the timer is on it interrupts every N instructions: the address of
+// the next instruction is pushed and the handler runs. Ticks while the
+// handler is running are held until its iret. The handler must save any
+// registers it uses; it can switch tasks by saving the current task's
+// registers and stack pointer and loading another's before iret.
+enum CpuOpcode
+{
+	OP_HALT,
+	OP_LOADI,
+	OP_MOV,
+	OP_ADD,
+	OP_ADDI,
+	OP_SUB,
+	OP_MUL,
+	OP_LOAD,
+	OP_STORE,
+	OP_COPY,
+	OP_JMP,
+	OP_JZ,
+	OP_JNZ,
+	OP_JLT,
+	OP_CALL,
+	OP_RET,
+	OP_PRINT,
+	OP_IVEC,
+	OP_IRET,
+	OP_COUNT
+};
+
+struct Instruction
+{
+	uint8_t opcode;
+	uint8_t a, b, c;   // Register numbers
+	int32_t imm;
+};
+
+const int REGISTER_COUNT = 8;
+const int SP = 7;
+
+#endif
@@ -1,26 +1,193 @@
+#include <algorithm>
 #include <iostream>
+#include <vector>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "mem_protocol.h"
 
-int main(int argc, const char** argv)
+// Commands arrive on stdin in chunks; a whole batch is usually one read
+static char input[64 * 1024];
+static size_t inputStart = 0, inputEnd = 0;
+
+static bool readInput(void* buffer, size_t length)
+{
+	char* p = (char*)buffer;
+	while(length > 0)
+	{
+		if(inputStart == inputEnd)
+		{
+			ssize_t got = read(0, input, sizeof(input));
+			if(got == -1 && errno == EINTR)
+				continue;
+			if(got <= 0)
+				return false;
+			inputStart = 0;
+			inputEnd = got;
+		}
+		size_t take = std::min(length, inputEnd - inputStart);
+		std::copy(input + inputStart, input + inputStart + take, p);
+		inputStart += take;
+		p += take;
+		length -= take;
+	}
+	return true;
+}
+
+static bool writeOutput(const void* buffer, size_t length)
 {
-	int memloc = 0;
+	const char* p = (const char*)buffer;
+	while(length > 0)
+	{
+		ssize_t written = write(1, p, length);
+		if(written == -1 && errno == EINTR)
+			continue;
+		if(written <= 0)
+			return false;
+		p += written;
+		length -= written;
+	}
+	return true;
+}
 
-    char mode;
+// The memory itself. Pages are only allocated once touched, so a 4 GB
+// memory costs nothing until a program uses it.
+static char* memory;
+static uint64_t memoryBytes;
 
-	std::cin.read(&mode,1);
+static bool inRange(uint32_t addr, uint64_t length)
+{
+	if(addr + length <= memoryBytes)
+		return true;
+	std::cerr << "mem: access at " << addr << " (" << length << " bytes) is out of range" << std::endl;
+	return false;
+}
 
-	while(mode != 2)
+static int load(uint32_t addr)
+{
+	int value = 0;
+	if(inRange(addr, sizeof(int)))
+		memcpy(&value, memory + addr, sizeof(int));
+	return value;
+}
+
+static void store(uint32_t addr, int value)
+{
+	if(inRange(addr, sizeof(int)))
+		memcpy(memory + addr, &value, sizeof(int));
+}
+
+int main(int argc, const char** argv)
+{
+	memoryBytes = argc > 1 ? strtoull(argv[1], NULL, 10) : MEM_DEFAULT_BYTES;
+	if(memoryBytes == 0 || memoryBytes > MEM_MAX_BYTES)
 	{
+		std::cerr << "mem: size must be between 1 and " << MEM_MAX_BYTES << " bytes" << std::endl;
+		return 1;
+	}
+	// Shared mode: cpu passes a memfd it maps too, and accesses most of
+	// memory directly instead of sending commands
+	if(argc > 2)
+	{
+		int fd = atoi(argv[2]);
+		memory = (char*)mmap(NULL, memoryBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0);
+		close(fd);
+	}
+	else
+		memory = (char*)mmap(NULL, memoryBytes, PROT_READ | PROT_WRITE,
+		                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(memory == MAP_FAILED)
+	{
+		perror("mem: mmap failed");
+		return 1;
+	}
+
+	std::vector<MemOp> batch;
+	std::vector<int> replies;
+	std::vector<char> block;
+	char mode;
+
+	// End of input halts too, so a dead cpu doesn't leave mem behind
+	while(readInput(&mode,1) && mode != MEM_HALT)
+	{
+		uint32_t addr, src, length;
 		switch(mode)
 		{
-			case 0:
-				std::cout.write((char*)&memloc,sizeof(int));
+			case MEM_READ:
+			{
+				readInput(&addr,sizeof(addr));
+				int value = load(addr);
+				writeOutput(&value,sizeof(int));
 				break;
-			case 1:
-				std::cin.read((char*)&memloc,sizeof(int));
+			}
+			case MEM_WRITE:
+			{
+				int value;
+				readInput(&addr,sizeof(addr));
+				readInput(&value,sizeof(int));
+				store(addr, value);
 				break;
-		}
+			}
+			case MEM_BATCH:
+			{
+				uint32_t count;
+				if(!readInput(&count,sizeof(count)) || count > MEM_MAX_BATCH)
+				{
+					std::cerr << "mem: bad batch" << std::endl;
+					return 1;
+				}
+				batch.resize(count);
+				readInput(batch.data(),count * sizeof(MemOp));
 
-	    std::cin.read(&mode,1);
+				// Every read in the batch is answered by one write
+				replies.clear();
+				for(const MemOp& op : batch)
+				{
+					if(op.opcode == MEM_WRITE)
+						store(op.addr, op.value);
+					else if(op.opcode == MEM_READ)
+						replies.push_back(load(op.addr));
+				}
+				if(!replies.empty())
+					writeOutput(replies.data(),replies.size() * sizeof(int));
+				break;
+			}
+			case MEM_COPY:
+				readInput(&addr,sizeof(addr));
+				readInput(&src,sizeof(src));
+				readInput(&length,sizeof(length));
+				if(inRange(addr, length) && inRange(src, length))
+					memmove(memory + addr, memory + src, length);
+				break;
+			case MEM_LOAD:
+			case MEM_STORE:
+				readInput(&addr,sizeof(addr));
+				readInput(&length,sizeof(length));
+				if(length > MEM_MAX_BLOCK)
+				{
+					std::cerr << "mem: bad block" << std::endl;
+					return 1;
+				}
+				block.assign(length, 0);
+				if(mode == MEM_LOAD)
+				{
+					if(inRange(addr, length))
+						memcpy(block.data(), memory + addr, length);
+					writeOutput(block.data(),length);
+				}
+				else
+				{
+					readInput(block.data(),length);
+					if(inRange(addr, length))
+						memcpy(memory + addr, block.data(), length);
+				}
+				break;
+			default:
+				std::cerr << "mem: unknown command " << (int)mode << std::endl;
+				return 1;
+		}
 	}
 
 	return 0;
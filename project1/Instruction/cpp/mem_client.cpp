@@ -0,0 +1,276 @@
+#include "mem_client.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static void writeAll(int fd, struct iovec* iov, int count)
+{
+	while(count > 0)
+	{
+		ssize_t written = writev(fd, iov, count);
+		if(written == -1)
+		{
+			if(errno == EINTR)
+				continue;
+			perror("Unable to write to mem");
+			exit(-1);
+		}
+		// Skip past what went out; a pipe may take a large frame in pieces
+		while(count > 0 && (size_t)written >= iov->iov_len)
+		{
+			written -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		if(count > 0)
+		{
+			iov->iov_base = (char*)iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+}
+
+static void readAll(int fd, void* buffer, size_t length)
+{
+	char* p = (char*)buffer;
+	while(length > 0)
+	{
+		ssize_t got = ::read(fd, p, length);
+		if(got == -1 && errno == EINTR)
+			continue;
+		if(got <= 0)
+		{
+			std::cerr << "mem closed the pipe" << std::endl;
+			exit(-1);
+		}
+		p += got;
+		length -= got;
+	}
+}
+
+MemClient::MemClient() : toMem(-1), fromMem(-1), child(-1), shared(NULL), bytes(0),
+	commandCount(0), sent(0), received(0)
+{
+}
+
+MemClient::~MemClient()
+{
+	if(child != -1)
+		halt();
+}
+
+void MemClient::start(const char* path, uint64_t bytes, bool shared)
+{
+	this->bytes = bytes;
+
+	// Created without close-on-exec so mem inherits it
+	int memfd = -1;
+	if(shared)
+	{
+		memfd = memfd_create("mem", 0);
+		if(memfd == -1 || ftruncate(memfd, bytes) == -1)
+		{
+			perror("Unable to create shared memory");
+			exit(-1);
+		}
+		void* mapping = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, memfd, 0);
+		if(mapping == MAP_FAILED)
+		{
+			perror("Unable to map shared memory");
+			exit(-1);
+		}
+		this->shared = (char*)mapping;
+	}
+
+	// To store pipe identifiers
+	// p1[0] - read from pipe
+	// p1[1] - write to pipe
+	int p1[2],p2[2];
+
+	if(pipe(p1) == -1 || pipe(p2) == -1)
+	{
+		std::cerr << "Unable to create pipes" << std::endl;
+		exit(-1);
+	}
+
+	child = fork();
+	if(child == -1)
+	{
+		std::cerr << "Error forking" << std::endl;
+		exit(-1);
+	}
+
+	if(child == 0)
+	{
+		//I am the child process
+		close(p1[1]); // p1 is for reading
+		close(p2[0]); // p2 is for writing
+		dup2(p1[0], 0); //map pipe to stdin
+		dup2(p2[1], 1); //map pipe to stdout
+
+		std::string size = std::to_string(bytes);
+		std::string fd = std::to_string(memfd);
+		char *args[] = {(char*)path,(char*)size.c_str(),shared ? (char*)fd.c_str() : NULL,NULL};
+		execvp(args[0],args); //replace this program with the mem program
+		perror("Unable to run mem");
+		_exit(-1);
+	}
+
+	close(p1[0]);
+	close(p2[1]);
+	if(memfd != -1)
+		close(memfd);
+	toMem = p1[1];
+	fromMem = p2[0];
+}
+
+void MemClient::halt()
+{
+	flush();
+	char tmp = MEM_HALT;
+	send(&tmp, 1);
+	close(toMem);
+	close(fromMem);
+	waitpid(child, NULL, 0);
+	child = -1;
+	if(shared != NULL)
+	{
+		munmap(shared, bytes);
+		shared = NULL;
+	}
+}
+
+void MemClient::send(const void* header, size_t headerLength, const void* data, size_t dataLength)
+{
+	struct iovec iov[2] = {
+		{(void*)header, headerLength},
+		{(void*)data, dataLength}
+	};
+	writeAll(toMem, iov, dataLength > 0 ? 2 : 1);
+	commandCount++;
+	sent += headerLength + dataLength;
+}
+
+void MemClient::receive(void* buffer, size_t length)
+{
+	readAll(fromMem, buffer, length);
+	received += length;
+}
+
+void MemClient::sendWrite(uint32_t addr, int value)
+{
+	MemOp op = {MEM_WRITE, addr, value};
+	send(&op, sizeof(op));
+}
+
+int MemClient::sendRead(uint32_t addr)
+{
+	MemOp op = {MEM_READ, addr, 0};
+	send(&op, 1 + sizeof(addr));
+	int val;
+	receive(&val, sizeof(int));
+	return val;
+}
+
+void MemClient::copy(uint32_t dst, uint32_t src, uint32_t length)
+{
+	if(mapped(dst, length) && mapped(src, length))
+	{
+		memmove(shared + dst, shared + src, length);
+		return;
+	}
+	flush();
+	struct __attribute__((packed)) { uint8_t opcode; uint32_t dst, src, length; } command =
+		{MEM_COPY, dst, src, length};
+	send(&command, sizeof(command));
+}
+
+void MemClient::sendLoad(uint32_t addr, void* buffer, uint32_t length)
+{
+	flush();
+	// Large blocks go in pieces mem is willing to buffer
+	for(uint64_t done = 0; done < length; done += MEM_MAX_BLOCK)
+	{
+		uint32_t piece = std::min<uint64_t>(length - done, MEM_MAX_BLOCK);
+		struct __attribute__((packed)) { uint8_t opcode; uint32_t addr, length; } command =
+			{MEM_LOAD, (uint32_t)(addr + done), piece};
+		send(&command, sizeof(command));
+		receive((char*)buffer + done, piece);
+	}
+}
+
+void MemClient::store(uint32_t addr, const void* buffer, uint32_t length)
+{
+	if(mapped(addr, length))
+	{
+		memcpy(shared + addr, buffer, length);
+		return;
+	}
+	flush();
+	for(uint64_t done = 0; done < length; done += MEM_MAX_BLOCK)
+	{
+		uint32_t piece = std::min<uint64_t>(length - done, MEM_MAX_BLOCK);
+		struct __attribute__((packed)) { uint8_t opcode; uint32_t addr, length; } command =
+			{MEM_STORE, (uint32_t)(addr + done), piece};
+		send(&command, sizeof(command), (const char*)buffer + done, piece);
+	}
+}
+
+void MemClient::queueWrite(uint32_t addr, int value)
+{
+	if(mapped(addr, sizeof(int)))
+	{
+		write(addr, value);
+		return;
+	}
+	if(ops.size() == MEM_MAX_BATCH)
+		flush();
+	ops.push_back({MEM_WRITE, addr, value});
+}
+
+void MemClient::queueRead(uint32_t addr, int* result)
+{
+	if(mapped(addr, sizeof(int)))
+	{
+		*result = read(addr);
+		return;
+	}
+	if(ops.size() == MEM_MAX_BATCH)
+		flush();
+	ops.push_back({MEM_READ, addr, 0});
+	results.push_back(result);
+}
+
+void MemClient::flush()
+{
+	if(ops.empty())
+		return;
+
+	char tmp = MEM_BATCH;
+	uint32_t count = ops.size();
+	struct iovec iov[3] = {
+		{&tmp, 1},
+		{&count, sizeof(count)},
+		{ops.data(), ops.size() * sizeof(MemOp)}
+	};
+	writeAll(toMem, iov, 3);
+	commandCount++;
+	sent += 1 + sizeof(count) + ops.size() * sizeof(MemOp);
+
+	if(!results.empty())
+	{
+		replies.resize(results.size());
+		receive(replies.data(), replies.size() * sizeof(int));
+		for(size_t i = 0; i < results.size(); i++)
+			*results[i] = replies[i];
+	}
+	ops.clear();
+	results.clear();
+}
@@ -0,0 +1,94 @@
+#ifndef MEM_CLIENT_H
+#define MEM_CLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <vector>
+#include "mem_protocol.h"
+
+// cpu's end of the two pipes to a mem process.
+//
+// In shared mode the memory is a memfd that cpu creates and mem inherits
+// across exec. Both processes map it, so reads, writes and block commands
+// are plain memory accesses in cpu, and only halt still goes over the pipe.
+class MemClient
+{
+public:
+	MemClient();
+	~MemClient();
+
+	// Forks and execs the mem program with its stdin/stdout on the pipes,
+	// asking for a memory of the given size
+	void start(const char* path, uint64_t bytes = MEM_DEFAULT_BYTES, bool shared = false);
+	// Sends any queued ops, then MEM_HALT, and waits for mem to exit
+	void halt();
+
+	// Per-op protocol: a command per write call, a round trip per read.
+	// In shared mode, a plain memory access.
+	void write(uint32_t addr, int value)
+	{
+		if(mapped(addr, sizeof(int)))
+			memcpy(shared + addr, &value, sizeof(int));
+		else
+			sendWrite(addr, value);
+	}
+
+	int read(uint32_t addr)
+	{
+		if(!mapped(addr, sizeof(int)))
+			return sendRead(addr);
+		int value;
+		memcpy(&value, shared + addr, sizeof(int));
+		return value;
+	}
+
+	// Block commands; queued ops are sent first so ordering is kept
+	void copy(uint32_t dst, uint32_t src, uint32_t length);
+	void store(uint32_t addr, const void* buffer, uint32_t length);
+	void load(uint32_t addr, void* buffer, uint32_t length)
+	{
+		if(mapped(addr, length))
+			memcpy(buffer, shared + addr, length);
+		else
+			sendLoad(addr, buffer, length);
+	}
+
+	// Batched protocol: ops are queued and flush() sends them as one frame
+	// with a single writev, then fills in every queued read's result from
+	// mem's single reply. A full batch is flushed automatically.
+	void queueWrite(uint32_t addr, int value);
+	void queueRead(uint32_t addr, int* result);
+	size_t queued() const { return ops.size(); }
+	void flush();
+
+	// Pipe traffic so far; a batch counts as one command
+	uint64_t commands() const { return commandCount; }
+	uint64_t bytesSent() const { return sent; }
+	uint64_t bytesReceived() const { return received; }
+
+private:
+	// Out-of-range shared accesses take the slow path to get mem's behaviour
+	bool mapped(uint32_t addr, uint64_t length) const { return shared != NULL && addr + length <= bytes; }
+
+	void sendWrite(uint32_t addr, int value);
+	int sendRead(uint32_t addr);
+	void sendLoad(uint32_t addr, void* buffer, uint32_t length);
+	void receive(void* buffer, size_t length);
+	void send(const void* header, size_t headerLength, const void* data = NULL, size_t dataLength = 0);
+
+	int toMem;
+	int fromMem;
+	pid_t child;
+	char* shared;
+	uint64_t bytes;
+	uint64_t commandCount;
+	uint64_t sent;
+	uint64_t received;
+	std::vector<MemOp> ops;
+	std::vector<int*> results;
+	std::vector<int> replies;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef MEM_PROTOCOL_H
+#define MEM_PROTOCOL_H
+
+#include <stdint.h>
+
+// Commands cpu sends to mem. Each starts with one opcode byte; addresses
+// are byte addresses and values are 4-byte ints:
+//   MEM_READ <addr>                   mem replies with the int at addr
+//   MEM_WRITE <addr> <int>
+//   MEM_HALT
+//   MEM_BATCH <uint32 count> <count MemOps>
+//                                     mem replies once, with one int for
+//                                     every MEM_READ in the batch, in order
+//   MEM_COPY <dst> <src> <length>     copies length bytes inside mem
+//   MEM_LOAD <addr> <length>          mem replies with length bytes
+//   MEM_STORE <addr> <length> <bytes>
+// Accesses past the end of memory read as zeros and are not stored.
+enum MemOpcode
+{
+	MEM_READ = 0,
+	MEM_WRITE = 1,
+	MEM_HALT = 2,
+	MEM_BATCH = 3,
+	MEM_COPY = 4,
+	MEM_LOAD = 5,
+	MEM_STORE = 6
+};
+
+// One read or write inside a batch; the value is ignored for reads
+struct __attribute__((packed)) MemOp
+{
+	uint8_t opcode;
+	uint32_t addr;
+	int32_t value;
+};
+
+// mem refuses larger batches and blocks, so its buffers stay bounded
+const uint32_t MEM_MAX_BATCH = 4096;
+const uint32_t MEM_MAX_BLOCK = 1024 * 1024;
+
+// mem's size is its first argument; addresses are 32 bits, so up to 4 GB
+const uint64_t MEM_DEFAULT_BYTES = 64 * 1024;
+const uint64_t MEM_MAX_BYTES = 4ULL * 1024 * 1024 * 1024;
+
+#endif
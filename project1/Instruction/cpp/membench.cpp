@@ -0,0 +1,118 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <stdlib.h>
+#include "mem_client.h"
+
+// Reads and writes mixed half and half, over consecutive words or
+// randomly chosen ones
+static std::vector<MemOp> makeOps(bool random, size_t count)
+{
+	std::vector<MemOp> ops(count);
+	std::mt19937 rng(42);
+	uint32_t words = MEM_DEFAULT_BYTES / sizeof(int);
+	for(size_t i = 0; i < count; i++)
+	{
+		bool write = rng() & 1;
+		ops[i].opcode = write ? MEM_WRITE : MEM_READ;
+		ops[i].addr = (random ? rng() % words : i % words) * sizeof(int);
+		ops[i].value = write ? (int)rng() : 0;
+	}
+	return ops;
+}
+
+// What every read should return
+static std::vector<int> expectedReads(const std::vector<MemOp>& ops)
+{
+	std::vector<int> expected;
+	std::vector<int> memory(MEM_DEFAULT_BYTES / sizeof(int));
+	for(const MemOp& op : ops)
+	{
+		if(op.opcode == MEM_WRITE)
+			memory[op.addr / sizeof(int)] = op.value;
+		else
+			expected.push_back(memory[op.addr / sizeof(int)]);
+	}
+	return expected;
+}
+
+struct Protocol
+{
+	std::string name;
+	size_t batch;   // 0 sends each op on its own
+	bool shared;
+};
+
+// Runs the ops against a fresh mem and returns ops/sec
+static double run(const std::vector<MemOp>& ops, const Protocol& protocol)
+{
+	std::vector<int> expected = expectedReads(ops);
+	std::vector<int> got(expected.size());
+
+	MemClient mem;
+	mem.start("./mem", MEM_DEFAULT_BYTES, protocol.shared);
+	size_t batch = protocol.batch;
+
+	auto start = std::chrono::steady_clock::now();
+	size_t reads = 0;
+	for(const MemOp& op : ops)
+	{
+		if(batch == 0)
+		{
+			if(op.opcode == MEM_WRITE)
+				mem.write(op.addr, op.value);
+			else
+				got[reads++] = mem.read(op.addr);
+			continue;
+		}
+		if(op.opcode == MEM_WRITE)
+			mem.queueWrite(op.addr, op.value);
+		else
+			mem.queueRead(op.addr, &got[reads++]);
+		if(mem.queued() == batch)
+			mem.flush();
+	}
+	mem.flush();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	mem.halt();
+
+	if(got != expected)
+	{
+		std::cerr << "membench: mem returned wrong values" << std::endl;
+		exit(1);
+	}
+	return ops.size() / seconds;
+}
+
+int main(int argc, const char** argv)
+{
+	size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+	Protocol protocols[] = {
+		{"per-op", 0, false},
+		{"batch 16", 16, false},
+		{"batch 256", 256, false},
+		{"batch " + std::to_string(MEM_MAX_BATCH), MEM_MAX_BATCH, false},
+		{"shared", 0, true}
+	};
+
+	std::cout << std::left << std::setw(12) << "pattern" << std::setw(16) << "protocol"
+	          << std::right << std::setw(14) << "ops/sec" << std::setw(12) << "speedup" << std::endl;
+	for(int random = 0; random < 2; random++)
+	{
+		std::vector<MemOp> ops = makeOps(random, count);
+		double perOp = 0;
+		for(const Protocol& protocol : protocols)
+		{
+			double rate = run(ops, protocol);
+			if(perOp == 0)
+				perOp = rate;
+			std::cout << std::left << std::setw(12) << (random ? "random" : "sequential")
+			          << std::setw(16) << protocol.name << std::right << std::fixed << std::setprecision(0)
+			          << std::setw(14) << rate << std::setprecision(1) << std::setw(11) << rate / perOp << "x"
+			          << std::endl;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,16 @@
+# Calls a small function two million times, then prints the total
+        loadi r0, 0             # total
+        loadi r1, 0             # i
+        loadi r2, 2000000
+loop:   call  step
+        addi  r1, r1, 1
+        jlt   r1, r2, loop
+        print r0
+        halt
+
+# total += i * 3
+step:   addi  r3, r1, 0
+        add   r3, r3, r1
+        add   r3, r3, r1
+        add   r0, r0, r3
+        ret
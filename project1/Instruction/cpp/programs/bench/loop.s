@@ -0,0 +1,23 @@
+# A tight loop for measuring emulation speed. With --timer, the handler
+# counts the ticks, and the count is printed at the end.
+        ivec  tick
+        loadi r0, 0
+        loadi r1, 20000000
+loop:   addi  r0, r0, 1
+        jlt   r0, r1, loop
+        loadi r2, 0
+        load  r3, r2, ticks
+        print r3
+        halt
+
+tick:   store r4, sp, -4
+        store r5, sp, -8
+        loadi r5, 0
+        load  r4, r5, ticks
+        addi  r4, r4, 1
+        store r4, r5, ticks
+        load  r5, sp, -8
+        load  r4, sp, -4
+        iret
+
+ticks:  .word 0
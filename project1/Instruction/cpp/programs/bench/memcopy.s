@@ -0,0 +1,34 @@
+# Copies a 4 KB buffer one word at a time, 2000 times, then prints a checksum
+        loadi r0, 0
+        loadi r1, 1024
+        loadi r2, src
+init:   store r0, r2, 0         # src[i] = i
+        addi  r2, r2, 4
+        addi  r0, r0, 1
+        jlt   r0, r1, init
+
+        loadi r6, 2000
+pass:   loadi r2, src
+        loadi r3, dst
+        loadi r4, dst_end
+word:   load  r5, r2, 0
+        store r5, r3, 0
+        addi  r2, r2, 4
+        addi  r3, r3, 4
+        jlt   r3, r4, word
+        addi  r6, r6, -1
+        jnz   r6, pass
+
+        # Sum of 0..1023
+        loadi r0, 0
+        loadi r3, dst
+sum:    load  r5, r3, 0
+        add   r0, r0, r5
+        addi  r3, r3, 4
+        jlt   r3, r4, sum
+        print r0
+        halt
+
+src:     .space 4096
+dst:     .space 4096
+dst_end:
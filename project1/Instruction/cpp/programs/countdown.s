@@ -0,0 +1,10 @@
+# The original cpu demo: store 10, 9, ... 1 in memory and read each back
+        loadi r0, 10
+loop:   store r0, r1, cell
+        load  r2, r1, cell
+        print r2
+        addi  r0, r0, -1
+        jnz   r0, loop
+        halt
+
+cell:   .word 0
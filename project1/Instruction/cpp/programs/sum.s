@@ -0,0 +1,32 @@
+# Fills an array with 1..n, copies it, then sums the copy with a function call per element
+        loadi r0, 0             # i
+        loadi r1, 100           # n
+        loadi r3, src
+fill:   addi  r2, r0, 1
+        store r2, r3, 0
+        addi  r3, r3, 4
+        addi  r0, r0, 1
+        jlt   r0, r1, fill
+
+        loadi r0, dst
+        loadi r1, src
+        loadi r2, 400
+        copy  r0, r1, r2
+
+        loadi r4, 0             # total
+        loadi r3, dst
+        loadi r5, end
+next:   call  add
+        addi  r3, r3, 4
+        jlt   r3, r5, next
+        print r4                # 5050
+        halt
+
+# r4 += the int at r3
+add:    load  r6, r3, 0
+        add   r4, r4, r6
+        ret
+
+src:    .space 400
+dst:    .space 400
+end:
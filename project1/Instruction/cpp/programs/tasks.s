@@ -0,0 +1,72 @@
+# Two tasks share the cpu. Run with a timer, e.g. ./cpu --timer 100 programs/tasks.s
+# Each task prints its id plus a round number after every round of work,
+# so the output interleaves as the timer handler switches between them.
+
+        ivec  switch
+        jmp   taskA
+
+# Task A prints 101..105, task B 201..205
+taskA:  loadi r0, 101
+        jmp   rounds
+taskB:  loadi r0, 201
+rounds: addi  r3, r0, 5
+round:  loadi r1, 0
+        loadi r2, 200
+spin:   addi  r1, r1, 1
+        jlt   r1, r2, spin
+        print r0
+        addi  r0, r0, 1
+        jlt   r0, r3, round
+
+        # The second task to finish halts; the first waits to be switched away
+        loadi r1, 0
+        load  r2, r1, done
+        addi  r2, r2, 1
+        store r2, r1, done
+        addi  r2, r2, -2
+        jz    r2, finish
+wait:   jmp   wait
+finish: halt
+
+# Saves r0-r7 of the running task, then resumes the other one. The
+# interrupted pc is on top of each task's stack, so iret returns into
+# whichever task's stack is loaded.
+switch: store r6, sp, -4
+        loadi r6, 0
+        load  r6, r6, current
+        store r0, r6, 0
+        store r1, r6, 4
+        store r2, r6, 8
+        store r3, r6, 12
+        store r4, r6, 16
+        store r5, r6, 20
+        load  r0, sp, -4
+        store r0, r6, 24
+        store sp, r6, 28
+
+        load  r6, r6, 32        # The other task's save area
+        loadi r0, 0
+        store r6, r0, current
+
+        load  sp, r6, 28
+        load  r0, r6, 0
+        load  r1, r6, 4
+        load  r2, r6, 8
+        load  r3, r6, 12
+        load  r4, r6, 16
+        load  r5, r6, 20
+        load  r6, r6, 24
+        iret
+
+done:    .word 0
+current: .word saveA
+
+# Save areas: r0-r6, sp, then the other task's area
+saveA:   .space 28
+         .word 0, saveB
+saveB:   .space 28
+         .word startB, saveA
+
+# Task B's stack starts out holding its entry point, for the first iret
+stackB:  .space 64
+startB:  .word taskB
@@ -0,0 +1,226 @@
+#include "binary_log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include "trace.h"
+
+using namespace std;
+
+const char BINARY_LOG_MAGIC[8] = {'D', 'R', 'V', 'L', 'O', 'G', 'B', '1'};
+const char BINARY_INDEX_SUFFIX[] = ".idx";
+
+static void put(string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+static uint64_t get(const char* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    }
+    return value;
+}
+
+BinaryLogWriter::BinaryLogWriter(RotatingLog& log)
+    : log(log), other_defined(false), last_timestamp(0), since_index(BINARY_INDEX_INTERVAL) {}
+
+bool BinaryLogWriter::start() {
+    if (log.size() == 0) {
+        begin_file();
+        return true;
+    }
+
+    // Appending: keep using the ids this file already defined
+    BinaryLogIndex index;
+    if (!index.load(log.sidecar_path())) {
+        return false;
+    }
+    for (size_t id = 0; id < index.actions.size(); id++) {
+        if (id == BINARY_OTHER_ACTION) {
+            other_defined = true;
+        } else if (!index.actions[id].empty()) {
+            actions[index.actions[id]] = id;
+        }
+    }
+    if (!index.points.empty()) {
+        last_timestamp = index.points.back().first;
+    }
+    since_index = BINARY_INDEX_INTERVAL;
+    return true;
+}
+
+void BinaryLogWriter::begin_file() {
+    // Every file is self-contained: its index defines the actions it uses
+    actions.clear();
+    other_defined = false;
+    log.append(string(BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC)));
+    since_index = BINARY_INDEX_INTERVAL;
+}
+
+uint16_t BinaryLogWriter::action_id(string_view action) {
+    auto found = actions.find(string(action));
+    if (found != actions.end()) {
+        return found->second;
+    }
+
+    // Every id below the reserved one taken, or a name the index can't hold
+    if (actions.size() >= BINARY_OTHER_ACTION || action.size() > BINARY_MAX_ACTION_NAME) {
+        if (!other_defined) {
+            define_action(BINARY_OTHER_ACTION, "OTHER");
+            other_defined = true;
+        }
+        return BINARY_OTHER_ACTION;
+    }
+
+    uint16_t id = actions.size();
+    actions[string(action)] = id;
+    define_action(id, action);
+    return id;
+}
+
+void BinaryLogWriter::define_action(uint16_t id, string_view name) {
+    entry.clear();
+    entry += 'A';
+    put(entry, id, 2);
+    put(entry, name.size(), 2);
+    entry.append(name.data(), name.size());
+    log.append_sidecar(entry);
+}
+
+void BinaryLogWriter::write(uint64_t timestamp_ns, string_view action, string_view message) {
+    TRACE_SPAN("binary log write", "logger");
+    if (log.rotate_if_due(BINARY_RECORD_HEADER + message.size())) {
+        begin_file();
+    }
+
+    // A clock step backwards must not break the ordering queries rely on
+    timestamp_ns = max(timestamp_ns, last_timestamp);
+    last_timestamp = timestamp_ns;
+
+    uint16_t id = action_id(action);
+    if (id == BINARY_OTHER_ACTION) {
+        other.assign(action.data(), action.size());
+        other += ' ';
+        other.append(message.data(), message.size());
+        message = other;
+    }
+    if (since_index >= BINARY_INDEX_INTERVAL) {
+        entry.clear();
+        entry += 'T';
+        put(entry, timestamp_ns, 8);
+        put(entry, log.size(), 8);
+        log.append_sidecar(entry);
+        since_index = 0;
+    }
+
+    record.clear();
+    put(record, timestamp_ns, 8);
+    put(record, id, 2);
+    put(record, message.size(), 4);
+    record.append(message.data(), message.size());
+    log.append(record);
+    since_index++;
+}
+
+bool BinaryLogIndex::load(const string& path) {
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    string contents((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+
+    actions.clear();
+    points.clear();
+    size_t pos = 0;
+    while (pos < contents.size()) {
+        char type = contents[pos];
+        if (type == 'A' && pos + 5 <= contents.size()) {
+            size_t id = get(&contents[pos + 1], 2);
+            size_t length = get(&contents[pos + 3], 2);
+            if (pos + 5 + length > contents.size()) {
+                break;
+            }
+            if (id >= actions.size()) {
+                actions.resize(id + 1);
+            }
+            actions[id] = contents.substr(pos + 5, length);
+            pos += 5 + length;
+        } else if (type == 'T' && pos + 17 <= contents.size()) {
+            points.push_back(make_pair(get(&contents[pos + 1], 8), get(&contents[pos + 9], 8)));
+            pos += 17;
+        } else {
+            break;  // Truncated by a crash; what came before is still good
+        }
+    }
+    return true;
+}
+
+uint64_t BinaryLogIndex::seek(uint64_t timestamp) const {
+    // Last point strictly before timestamp: records equal to it may precede later points
+    auto after = lower_bound(points.begin(), points.end(), make_pair(timestamp, static_cast<uint64_t>(0)));
+    if (after == points.begin()) {
+        return sizeof(BINARY_LOG_MAGIC);
+    }
+    return prev(after)->second;
+}
+
+int BinaryLogIndex::find_action(string_view name) const {
+    for (size_t id = 0; id < actions.size(); id++) {
+        if (actions[id] == name) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+BinaryLogScanner::BinaryLogScanner(const char* data, size_t size, uint64_t offset)
+    : data(data), size(size), offset(max<uint64_t>(offset, sizeof(BINARY_LOG_MAGIC))) {}
+
+bool BinaryLogScanner::valid(const char* data, size_t size) {
+    return size >= sizeof(BINARY_LOG_MAGIC) && memcmp(data, BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC)) == 0;
+}
+
+bool BinaryLogScanner::next(uint64_t& timestamp_ns, uint16_t& action, string_view& message) {
+    if (offset + BINARY_RECORD_HEADER > size) {
+        return false;
+    }
+    const char* p = data + offset;
+    uint64_t length = get(p + 10, 4);
+    if (offset + BINARY_RECORD_HEADER + length > size) {
+        return false;
+    }
+    timestamp_ns = get(p, 8);
+    action = get(p + 8, 2);
+    message = string_view(p + BINARY_RECORD_HEADER, length);
+    offset += BINARY_RECORD_HEADER + length;
+    return true;
+}
+
+string binary_record_text(uint64_t timestamp_ns, string_view action, string_view message) {
+    // Consecutive records mostly share a second, so the stamp is reused
+    thread_local time_t cached_seconds = -1;
+    thread_local char stamp[64];
+    time_t seconds = timestamp_ns / 1000000000;
+    if (seconds != cached_seconds) {
+        struct tm timeInfo;
+        localtime_r(&seconds, &timeInfo);
+        snprintf(stamp, sizeof(stamp), "%04d-%02d-%02d %02d:%02d ",
+                 timeInfo.tm_year + 1900, timeInfo.tm_mon + 1, timeInfo.tm_mday,
+                 timeInfo.tm_hour, timeInfo.tm_min);
+        cached_seconds = seconds;
+    }
+
+    string text = stamp;
+    text += '[';
+    text.append(action.data(), action.size());
+    text += ']';
+    text.append(message.data(), message.size());
+    text += '\n';
+    return text;
+}
@@ -0,0 +1,94 @@
+#ifndef BINARY_LOG_H
+#define BINARY_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "log_rotator.h"
+
+// Compact log format, an alternative to the text lines.
+//
+// Data file: the 8-byte magic "DRVLOGB1", then records of
+//   [u64 timestamp in ns since the epoch][u16 action id][u32 length][message]
+// in little-endian order. Timestamps never decrease within a file.
+//
+// Sidecar index (<log>.idx), a sequence of entries:
+//   'A' [u16 id][u16 length][name]     action definition
+//   'T' [u64 timestamp][u64 offset]    sparse time index point
+// A time point is written for the first record of each file and then
+// every BINARY_INDEX_INTERVAL records, so a query seeks to the last point
+// before its start time instead of scanning the whole file.
+//
+// Ids run out at BINARY_OTHER_ACTION. Past that, and for names too long
+// for the u16 length, records are written under the reserved id
+// BINARY_OTHER_ACTION ("OTHER") with the real name as the first word of
+// the message.
+
+extern const char BINARY_LOG_MAGIC[8];
+extern const char BINARY_INDEX_SUFFIX[];
+const size_t BINARY_INDEX_INTERVAL = 64;
+const size_t BINARY_RECORD_HEADER = 14;
+const uint16_t BINARY_OTHER_ACTION = 0xffff;
+const size_t BINARY_MAX_ACTION_NAME = 0xffff;
+
+// Writes binary records through a RotatingLog opened with BINARY_INDEX_SUFFIX
+class BinaryLogWriter {
+public:
+    explicit BinaryLogWriter(RotatingLog& log);
+
+    // Picks up action ids from an existing index when appending to a file
+    bool start();
+    void write(uint64_t timestamp_ns, std::string_view action, std::string_view message);
+
+private:
+    void begin_file();
+    uint16_t action_id(std::string_view action);
+    void define_action(uint16_t id, std::string_view name);
+
+    RotatingLog& log;
+    std::unordered_map<std::string, uint16_t> actions;
+    bool other_defined;   // This file's index names BINARY_OTHER_ACTION
+    uint64_t last_timestamp;
+    size_t since_index;   // Records written since the last time point
+    std::string record;   // Reused for every record
+    std::string entry;
+    std::string other;    // Message of an OTHER record
+};
+
+// Contents of one index file
+struct BinaryLogIndex {
+    std::vector<std::string> actions;                      // Name by id
+    std::vector<std::pair<uint64_t, uint64_t>> points;     // (timestamp, offset)
+
+    bool load(const std::string& path);
+
+    // Offset to start scanning from for records at or after timestamp
+    uint64_t seek(uint64_t timestamp) const;
+    // Id of an action name, or -1 if the file never used it
+    int find_action(std::string_view name) const;
+};
+
+// Walks the records of a data file held in memory
+class BinaryLogScanner {
+public:
+    BinaryLogScanner(const char* data, size_t size, uint64_t offset);
+
+    static bool valid(const char* data, size_t size);
+
+    // False at the end of the data or at a truncated record
+    bool next(uint64_t& timestamp_ns, uint16_t& action, std::string_view& message);
+
+private:
+    const char* data;
+    size_t size;
+    uint64_t offset;
+};
+
+// Formats a record the way the text logger writes it
+std::string binary_record_text(uint64_t timestamp_ns, std::string_view action, std::string_view message);
+
+#endif
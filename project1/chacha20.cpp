@@ -0,0 +1,192 @@
+#include "chacha20.h"
+
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+const uint32_t SIGMA[4] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+const uint32_t KEY_NONCE[3] = {0x63616863, 0x30326168, 0x66646b2d};  // "chacha20-kdf"
+const uint64_t NO_BLOCK = ~0ULL;
+
+inline uint32_t rotl(uint32_t v, int n) {
+    return (v << n) | (v >> (32 - n));
+}
+
+#if defined(__GNUC__)
+#define CHACHA_VECTOR 1
+typedef uint32_t u32x4 __attribute__((vector_size(16)));
+
+inline u32x4 rotl(u32x4 v, int n) {
+    return (v << n) | (v >> (32 - n));
+}
+#endif
+
+template <typename T>
+inline void quarter_round(T& a, T& b, T& c, T& d) {
+    a += b; d ^= a; d = rotl(d, 16);
+    c += d; b ^= c; b = rotl(b, 12);
+    a += b; d ^= a; d = rotl(d, 8);
+    c += d; b ^= c; b = rotl(b, 7);
+}
+
+template <typename T>
+inline void double_rounds(T x[16]) {
+    for (int i = 0; i < 10; i++) {
+        quarter_round(x[0], x[4], x[8], x[12]);
+        quarter_round(x[1], x[5], x[9], x[13]);
+        quarter_round(x[2], x[6], x[10], x[14]);
+        quarter_round(x[3], x[7], x[11], x[15]);
+        quarter_round(x[0], x[5], x[10], x[15]);
+        quarter_round(x[1], x[6], x[11], x[12]);
+        quarter_round(x[2], x[7], x[8], x[13]);
+        quarter_round(x[3], x[4], x[9], x[14]);
+    }
+}
+
+inline void store32_le(uint8_t* out, uint32_t v) {
+    out[0] = v;
+    out[1] = v >> 8;
+    out[2] = v >> 16;
+    out[3] = v >> 24;
+}
+
+inline uint32_t load32_le(const uint8_t* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<uint32_t>(in[3]) << 24);
+}
+
+void initial_state(uint32_t state[16], const uint32_t key[8], uint32_t counter, const uint32_t nonce[3]) {
+    memcpy(state, SIGMA, sizeof(SIGMA));
+    memcpy(state + 4, key, 8 * sizeof(uint32_t));
+    state[12] = counter;
+    memcpy(state + 13, nonce, 3 * sizeof(uint32_t));
+}
+
+void xor_bytes(const char* in, const uint8_t* keystream, char* out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = in[i] ^ keystream[i];
+    }
+}
+
+}
+
+void chacha20_block(const uint32_t key[8], uint32_t counter, const uint32_t nonce[3], uint8_t out[64]) {
+    uint32_t state[16], x[16];
+    initial_state(state, key, counter, nonce);
+    memcpy(x, state, sizeof(state));
+    double_rounds(x);
+    for (int i = 0; i < 16; i++) {
+        store32_le(out + 4 * i, x[i] + state[i]);
+    }
+}
+
+void chacha20_blocks4(const uint32_t key[8], uint32_t counter, const uint32_t nonce[3], uint8_t out[256]) {
+#ifdef CHACHA_VECTOR
+    uint32_t state[16];
+    initial_state(state, key, counter, nonce);
+
+    // Lane j of every word belongs to block counter + j
+    u32x4 x[16], start[16];
+    for (int i = 0; i < 16; i++) {
+        start[i] = (u32x4){state[i], state[i], state[i], state[i]};
+    }
+    start[12] += (u32x4){0, 1, 2, 3};
+    memcpy(x, start, sizeof(start));
+
+    double_rounds(x);
+
+    for (int i = 0; i < 16; i++) {
+        u32x4 word = x[i] + start[i];
+        for (int lane = 0; lane < 4; lane++) {
+            store32_le(out + 64 * lane + 4 * i, word[lane]);
+        }
+    }
+#else
+    for (int lane = 0; lane < 4; lane++) {
+        chacha20_block(key, counter + lane, nonce, out + 64 * lane);
+    }
+#endif
+}
+
+ChaCha20Engine::ChaCha20Engine() : keyed(false), position(0), cached_index(NO_BLOCK) {
+    memset(key_words, 0, sizeof(key_words));
+    memcpy(nonce, KEY_NONCE, sizeof(nonce));
+}
+
+bool ChaCha20Engine::init(string_view key) {
+    keyed = !key.empty();
+    position = 0;
+    cached_index = NO_BLOCK;
+    if (!keyed) {
+        return false;
+    }
+
+    // Fold the password into 32 bytes, then expand it through one block
+    uint8_t folded[32] = {0};
+    for (size_t i = 0; i < key.size(); i++) {
+        folded[i % 32] = (folded[i % 32] * 31) ^ static_cast<uint8_t>(key[i]);
+    }
+    uint32_t seed[8];
+    for (int i = 0; i < 8; i++) {
+        seed[i] = load32_le(folded + 4 * i);
+    }
+    uint8_t expanded[64];
+    chacha20_block(seed, static_cast<uint32_t>(key.size()), KEY_NONCE, expanded);
+    for (int i = 0; i < 8; i++) {
+        key_words[i] = load32_le(expanded + 4 * i);
+    }
+    return true;
+}
+
+void ChaCha20Engine::set_nonce(const uint8_t* nonce_bytes) {
+    for (int i = 0; i < 3; i++) {
+        nonce[i] = load32_le(nonce_bytes + 4 * i);
+    }
+    position = 0;
+    cached_index = NO_BLOCK;
+}
+
+unique_ptr<CipherEngine> ChaCha20Engine::clone() const {
+    return unique_ptr<CipherEngine>(new ChaCha20Engine(*this));
+}
+
+const uint8_t* ChaCha20Engine::keystream_block(uint64_t block_index) {
+    if (cached_index != block_index) {
+        chacha20_block(key_words, static_cast<uint32_t>(block_index), nonce, cached_block);
+        cached_index = block_index;
+    }
+    return cached_block;
+}
+
+void ChaCha20Engine::xor_stream(const char* in, char* out, size_t n) {
+    // Finish a partially used block first
+    size_t offset = position % 64;
+    if (offset != 0 && n > 0) {
+        size_t take = min(n, 64 - offset);
+        xor_bytes(in, keystream_block(position / 64) + offset, out, take);
+        in += take;
+        out += take;
+        n -= take;
+        position += take;
+    }
+
+    uint8_t keystream[256];
+    while (n >= 256) {
+        chacha20_blocks4(key_words, static_cast<uint32_t>(position / 64), nonce, keystream);
+        xor_bytes(in, keystream, out, 256);
+        in += 256;
+        out += 256;
+        n -= 256;
+        position += 256;
+    }
+
+    while (n > 0) {
+        size_t take = min<size_t>(n, 64);
+        xor_bytes(in, keystream_block(position / 64), out, take);
+        in += take;
+        out += take;
+        n -= take;
+        position += take;
+    }
+}
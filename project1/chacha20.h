@@ -0,0 +1,57 @@
+#ifndef CHACHA20_H
+#define CHACHA20_H
+
+#include <cstddef>
+#include <cstdint>
+#include "cipher_engine.h"
+
+// ChaCha20 stream cipher (RFC 8439 block function), computed four blocks at
+// a time with one block per vector lane when the compiler supports GCC
+// vector extensions.
+void chacha20_block(const uint32_t key[8], uint32_t counter, const uint32_t nonce[3], uint8_t out[64]);
+void chacha20_blocks4(const uint32_t key[8], uint32_t counter, const uint32_t nonce[3], uint8_t out[256]);
+
+// ChaCha20 engine keyed from a password. The password is folded into 32
+// bytes and run through one ChaCha20 block to spread it over the key; this
+// is key expansion, not a password hash. Every message needs its own nonce
+// (set_nonce): the encryption program draws a random one per ENCRYPT and
+// sends it ahead of the ciphertext, so no two messages share a keystream.
+// Until one is set the engine uses a fixed nonce.
+class ChaCha20Engine : public CipherEngine {
+public:
+    ChaCha20Engine();
+
+    const char* name() const { return "CHACHA20"; }
+    bool init(std::string_view key);
+    bool ready() const { return keyed; }
+    void reset() { position = 0; }
+
+    void encrypt_update(const char* in, char* out, size_t n) { xor_stream(in, out, n); }
+    void decrypt_update(const char* in, char* out, size_t n) { xor_stream(in, out, n); }
+
+    bool binary_output() const { return true; }
+    uint64_t stream_advance(const char*, size_t n) const { return n; }
+    void seek(uint64_t stream_position) { position = stream_position; }
+
+    static const size_t NONCE_BYTES = 12;
+    size_t nonce_size() const { return NONCE_BYTES; }
+    void set_nonce(const uint8_t* nonce_bytes);
+
+    std::unique_ptr<CipherEngine> clone() const;
+
+private:
+    void xor_stream(const char* in, char* out, size_t n);
+    const uint8_t* keystream_block(uint64_t block_index);
+
+    uint32_t key_words[8];
+    uint32_t nonce[3];
+    bool keyed;
+    uint64_t position;
+
+    // Keystream of the most recent partial block, so short updates don't
+    // recompute it
+    uint8_t cached_block[64];
+    uint64_t cached_index;
+};
+
+#endif
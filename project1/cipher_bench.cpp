@@ -0,0 +1,170 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <random>
+#include <thread>
+#include "vigenere.h"
+#include "chacha20.h"
+#include "cipher_engine.h"
+
+using namespace std;
+
+// Compares the reference per-character cipher against the table-driven one
+// over a grid of key and input lengths, checking that both agree, then
+// reports GB/s for every cipher engine on the streaming and parallel paths.
+
+static string random_text(size_t length, mt19937& rng, bool spaces) {
+    const string letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    uniform_int_distribution<int> pick(0, letters.size() - 1);
+    uniform_int_distribution<int> space(0, 7);
+    string text(length, ' ');
+    for (size_t i = 0; i < length; i++) {
+        if (!spaces || space(rng) != 0) {
+            text[i] = letters[pick(rng)];
+        }
+    }
+    return text;
+}
+
+// Runs fn until at least min_seconds have passed and returns MB/s
+template <typename Fn>
+static double measure(size_t bytes_per_call, Fn fn, double min_seconds = 0.2) {
+    auto start = chrono::steady_clock::now();
+    size_t calls = 0;
+    double elapsed = 0;
+    do {
+        fn();
+        calls++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < min_seconds);
+    return (bytes_per_call * calls) / elapsed / 1e6;
+}
+
+// RFC 8439 section 2.3.2 block function test vector
+static bool chacha20_selftest() {
+    uint32_t key[8];
+    uint8_t key_bytes[32];
+    for (int i = 0; i < 32; i++) key_bytes[i] = i;
+    memcpy(key, key_bytes, sizeof(key));
+    const uint8_t nonce_bytes[12] = {0, 0, 0, 0x09, 0, 0, 0, 0x4a, 0, 0, 0, 0};
+    uint32_t nonce[3];
+    memcpy(nonce, nonce_bytes, sizeof(nonce));
+
+    const uint8_t expected[16] = {0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15,
+                                  0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4};
+    uint8_t block[64], blocks[256];
+    chacha20_block(key, 1, nonce, block);
+    chacha20_blocks4(key, 0, nonce, blocks);
+    return memcmp(block, expected, sizeof(expected)) == 0 && memcmp(blocks + 64, block, 64) == 0;
+}
+
+// Streaming in odd-sized pieces and the parallel path must match one-shot output
+static bool engine_selftest(CipherEngine& prototype, const string& text) {
+    unique_ptr<CipherEngine> engine = prototype.clone();
+    string oneshot(text.size(), '\0'), streamed(text.size(), '\0'), parallel(text.size(), '\0');
+    engine->encrypt(text.data(), &oneshot[0], text.size());
+
+    engine->reset();
+    for (size_t pos = 0, step = 1; pos < text.size(); pos += step, step = step * 3 % 1000 + 1) {
+        size_t length = min(step, text.size() - pos);
+        engine->encrypt_update(text.data() + pos, &streamed[0] + pos, length);
+    }
+
+    cipher_process_parallel(prototype, false, text.data(), &parallel[0], text.size(), 4);
+
+    string roundtrip(text.size(), '\0');
+    cipher_process_parallel(prototype, true, oneshot.data(), &roundtrip[0], text.size(), 4);
+    string upper = text;
+    if (!prototype.binary_output()) {
+        transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+    }
+    return streamed == oneshot && parallel == oneshot && roundtrip == upper;
+}
+
+int main() {
+    mt19937 rng(12345);
+    const size_t key_lengths[] = {4, 64, 4096};
+    const size_t input_lengths[] = {64, 64 * 1024, 4 * 1024 * 1024};
+
+    cout << setw(8) << "key" << setw(10) << "input"
+         << setw(14) << "ref MB/s" << setw(14) << "table MB/s" << setw(10) << "speedup\n";
+
+    for (size_t key_length : key_lengths) {
+        string key = random_text(key_length, rng, false);
+        KeySchedule schedule = build_key_schedule(key);
+
+        for (size_t input_length : input_lengths) {
+            string text = random_text(input_length, rng, true);
+            string out(text.size(), '\0');
+
+            // Both implementations must agree before timing means anything
+            vigenere_encrypt_into(text.data(), &out[0], text.size(), schedule);
+            string expected = vingener_encrypt(text, key);
+            if (out != expected) {
+                cerr << "Mismatch for key length " << key_length << ", input length " << input_length << "\n";
+                return 1;
+            }
+            vigenere_decrypt_into(out.data(), &out[0], out.size(), schedule);
+            if (out != vigenere_decrypt(expected, key)) {
+                cerr << "Decrypt mismatch for key length " << key_length << ", input length " << input_length << "\n";
+                return 1;
+            }
+
+            volatile size_t sink = 0;
+            double reference = measure(text.size(), [&]() {
+                sink += vingener_encrypt(text, key).size();
+            });
+            double table = measure(text.size(), [&]() {
+                vigenere_encrypt_into(text.data(), &out[0], text.size(), schedule);
+                sink += out[0];
+            });
+
+            cout << setw(8) << key_length << setw(10) << input_length
+                 << fixed << setprecision(1)
+                 << setw(14) << reference << setw(14) << table
+                 << setw(9) << table / reference << "x\n";
+        }
+    }
+
+    if (!chacha20_selftest()) {
+        cerr << "ChaCha20 does not match the RFC 8439 test vector\n";
+        return 1;
+    }
+
+    unsigned threads = max(1u, thread::hardware_concurrency());
+    const size_t engine_input = 16 * 1024 * 1024;
+    string text = random_text(engine_input, rng, true);
+    string out(text.size(), '\0');
+
+    cout << "\n" << setw(10) << "engine" << setw(16) << "stream GB/s"
+         << setw(16) << "parallel GB/s" << "  (" << threads << " threads, "
+         << engine_input / (1024 * 1024) << " MiB)\n";
+
+    const char* engines[] = {"VIGENERE", "CHACHA20"};
+    for (const char* name : engines) {
+        unique_ptr<CipherEngine> engine = make_cipher_engine(name);
+        engine->init(random_text(32, rng, false));
+        if (!engine_selftest(*engine, text.substr(0, 3 * 1024 * 1024 + 17))) {
+            cerr << name << ": streaming/parallel output differs from one-shot\n";
+            return 1;
+        }
+
+        volatile size_t sink = 0;
+        double stream = measure(text.size(), [&]() {
+            engine->encrypt(text.data(), &out[0], text.size());
+            sink += out[0];
+        });
+        double parallel = measure(text.size(), [&]() {
+            cipher_process_parallel(*engine, false, text.data(), &out[0], text.size(), threads);
+            sink += out[0];
+        });
+
+        cout << setw(10) << name << fixed << setprecision(3)
+             << setw(16) << stream / 1000 << setw(16) << parallel / 1000 << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "cipher_engine.h"
+
+#include <algorithm>
+#include <cctype>
+#include <thread>
+#include <vector>
+#include "chacha20.h"
+#include "trace.h"
+#include "vigenere.h"
+
+using namespace std;
+
+namespace {
+
+class VigenereEngine : public CipherEngine {
+public:
+    VigenereEngine() : key_index(0) {}
+
+    const char* name() const { return "VIGENERE"; }
+
+    bool init(string_view key) {
+        build_key_schedule(key, schedule);
+        key_index = 0;
+        return !schedule.empty();
+    }
+
+    bool ready() const { return !schedule.empty(); }
+    void reset() { key_index = 0; }
+
+    void encrypt_update(const char* in, char* out, size_t n) {
+        vigenere_encrypt_into(in, out, n, schedule, key_index);
+    }
+
+    void decrypt_update(const char* in, char* out, size_t n) {
+        vigenere_decrypt_into(in, out, n, schedule, key_index);
+    }
+
+    bool binary_output() const { return false; }
+
+    uint64_t stream_advance(const char* in, size_t n) const {
+        return vigenere_key_advance(in, n);
+    }
+
+    void seek(uint64_t position) {
+        key_index = schedule.empty() ? 0 : position % schedule.encrypt_shifts.size();
+    }
+
+    size_t nonce_size() const { return 0; }
+    void set_nonce(const uint8_t*) {}
+
+    unique_ptr<CipherEngine> clone() const {
+        return unique_ptr<CipherEngine>(new VigenereEngine(*this));
+    }
+
+private:
+    KeySchedule schedule;
+    size_t key_index;
+};
+
+// Below this a message is not worth handing to other threads
+const size_t MIN_PARALLEL_CHUNK = 256 * 1024;
+
+}
+
+unique_ptr<CipherEngine> make_cipher_engine(const string& name) {
+    string upper = name;
+    transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
+    if (upper == "VIGENERE") {
+        return unique_ptr<CipherEngine>(new VigenereEngine());
+    }
+    if (upper == "CHACHA20") {
+        return unique_ptr<CipherEngine>(new ChaCha20Engine());
+    }
+    return unique_ptr<CipherEngine>();
+}
+
+void cipher_process_parallel(CipherEngine& engine, bool decrypt,
+                             const char* in, char* out, size_t n, unsigned threads) {
+    TRACE_SPAN(decrypt ? "decrypt" : "encrypt", "cipher", engine.name());
+    size_t chunks = min<size_t>(max(threads, 1u), n / MIN_PARALLEL_CHUNK);
+    if (chunks <= 1) {
+        if (decrypt) {
+            engine.decrypt(in, out, n);
+        } else {
+            engine.encrypt(in, out, n);
+        }
+        return;
+    }
+
+    // Chunks start on 64-byte boundaries so block ciphers split on whole blocks
+    size_t chunk_size = (n / chunks + 63) & ~static_cast<size_t>(63);
+    vector<size_t> starts;
+    for (size_t start = 0; start < n; start += chunk_size) {
+        starts.push_back(start);
+    }
+    starts.push_back(n);
+    size_t count = starts.size() - 1;
+
+    // Pass 1: how far each chunk moves the stream
+    vector<uint64_t> positions(count + 1, 0);
+    vector<thread> workers;
+    for (size_t i = 0; i < count; i++) {
+        workers.push_back(thread([&, i]() {
+            positions[i + 1] = engine.stream_advance(in + starts[i], starts[i + 1] - starts[i]);
+        }));
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    for (size_t i = 1; i <= count; i++) {
+        positions[i] += positions[i - 1];
+    }
+
+    // Pass 2: each chunk on its own engine, seeked to where the stream stands
+    workers.clear();
+    for (size_t i = 0; i < count; i++) {
+        workers.push_back(thread([&, i]() {
+            TRACE_SPAN("cipher chunk", "cipher");
+            unique_ptr<CipherEngine> local = engine.clone();
+            local->seek(positions[i]);
+            size_t length = starts[i + 1] - starts[i];
+            if (decrypt) {
+                local->decrypt_update(in + starts[i], out + starts[i], length);
+            } else {
+                local->encrypt_update(in + starts[i], out + starts[i], length);
+            }
+        }));
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef CIPHER_ENGINE_H
+#define CIPHER_ENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Common interface for the ciphers the encryption program can run.
+// An engine is keyed once with init() and then processes a stream: each
+// *_update() call continues where the previous one stopped, and reset()
+// rewinds to the start of the stream.
+class CipherEngine {
+public:
+    virtual ~CipherEngine() {}
+
+    virtual const char* name() const = 0;
+
+    // Derives the engine's key material. Returns false if the key is unusable.
+    virtual bool init(std::string_view key) = 0;
+    virtual bool ready() const = 0;
+    virtual void reset() = 0;
+
+    virtual void encrypt_update(const char* in, char* out, size_t n) = 0;
+    virtual void decrypt_update(const char* in, char* out, size_t n) = 0;
+
+    // Ciphertext is arbitrary bytes and has to be hex-encoded on the text protocol
+    virtual bool binary_output() const = 0;
+
+    // Stream positioning used to split one message across threads:
+    // stream_advance() is how far n bytes of input move the stream, and
+    // seek() jumps to an absolute stream position.
+    virtual uint64_t stream_advance(const char* in, size_t n) const = 0;
+    virtual void seek(uint64_t position) = 0;
+
+    // Per-message nonce of nonce_size() bytes (0 if the cipher takes none),
+    // kept by clones. It selects the keystream until the next set_nonce().
+    static const size_t MAX_NONCE_SIZE = 16;
+    virtual size_t nonce_size() const = 0;
+    virtual void set_nonce(const uint8_t* nonce) = 0;
+
+    virtual std::unique_ptr<CipherEngine> clone() const = 0;
+
+    // One-shot helpers for a whole message
+    void encrypt(const char* in, char* out, size_t n) { reset(); encrypt_update(in, out, n); }
+    void decrypt(const char* in, char* out, size_t n) { reset(); decrypt_update(in, out, n); }
+};
+
+// Returns NULL for an unknown engine name ("VIGENERE" or "CHACHA20", any case)
+std::unique_ptr<CipherEngine> make_cipher_engine(const std::string& name);
+
+// Processes one message on up to `threads` threads, each working on its own
+// clone of the engine seeked to the start of its chunk. Small inputs run on
+// the calling thread through `engine` itself, without allocating.
+void cipher_process_parallel(CipherEngine& engine, bool decrypt,
+                             const char* in, char* out, size_t n, unsigned threads);
+
+#endif
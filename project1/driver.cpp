@@ -1,43 +1,61 @@
 #include <iostream>
-#include <vector>
 #include <string>
+#include <vector>
 #include <algorithm>
+#include <deque>
 #include <cstring>
 #include <cctype>
+#include <cstdlib>
+#include <csignal>
+#include <fcntl.h>
 #include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
 #include <sys/wait.h>
+#include "event_loop.h"
+#include "history_store.h"
+#include "result_cache.h"
+#include "supervisor.h"
+#include "trace.h"
 
 using namespace std;
 
 // Function to check if a string contains only alphabetic characters
 bool is_alpha_only(const string& str) {
-    return all_of(str.begin(), str.end(), [](char c) { 
-        return isalpha(c) || isspace(c); 
+    return all_of(str.begin(), str.end(), [](unsigned char c) {
+        return isalpha(c) || isspace(c);
     });
 }
 
-// Function to write to pipe with error checking
-void write_to_pipe(int pipe_fd, const string& message) {
-    ssize_t bytes_written = write(pipe_fd, message.c_str(), message.length());
-    if (bytes_written < 0) {
-        perror("Write to pipe failed");
-        exit(1);
-    }
+// Ciphertext from binary cipher modes arrives as hex
+bool is_hex_only(const string& str) {
+    return !str.empty() && str.size() % 2 == 0 && all_of(str.begin(), str.end(), [](unsigned char c) {
+        return isxdigit(c);
+    });
+}
+
+// Number of history entries shown at once
+const size_t HISTORY_PAGE_SIZE = 20;
+
+// Queued bytes allowed per child pipe before records are dropped
+const size_t MAX_QUEUED_BYTES = 8 * 1024 * 1024;
+
+// Encrypt/decrypt requests a batch run keeps outstanding at once
+const size_t BATCH_WINDOW = 1024;
+
+size_t history_pages(const HistoryStore& history) {
+    return (history.size() + HISTORY_PAGE_SIZE - 1) / HISTORY_PAGE_SIZE;
 }
 
-// Function to read from pipe with error checking
-string read_from_pipe(int pipe_fd) {
-    const int BUFFER_SIZE = 1024;
-    char buffer[BUFFER_SIZE];  // Proper array declaration
-    
-    ssize_t bytes_read = read(pipe_fd, buffer, BUFFER_SIZE - 1);
-    if (bytes_read < 0) {
-        perror("Read from pipe failed");
-        exit(1);
+// Prints one page of history, numbered from 1 like the selection prompt
+void display_history_page(const HistoryStore& history, size_t page) {
+    size_t begin = page * HISTORY_PAGE_SIZE;
+    size_t end = min(begin + HISTORY_PAGE_SIZE, history.size());
+
+    cout << "\n=== History (page " << page + 1 << "/" << history_pages(history) << ") ===\n";
+    for (size_t i = begin; i < end; i++) {
+        cout << i + 1 << ". " << history.at(i) << "\n";
     }
-    
-    buffer[bytes_read] = '\0';
-    return string(buffer);
 }
 
 void display_menu() {
@@ -46,291 +64,1004 @@ void display_menu() {
     cout << "encrypt  - Encrypt a string\n";
     cout << "decrypt  - Decrypt a string\n";
     cout << "history  - Show history of strings\n";
+    cout << "mode     - Select cipher (vigenere/chacha20)\n";
     cout << "quit     - Exit the program\n";
     cout << "==========================\n";
     cout << "Enter command: ";
 }
 
-int main(int argc, char* argv[]) {
-    // Ensure log file name is provided
-    if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " <log_file_name>\n";
-        return 1;
+// How the driver launches its children
+struct DriverOptions {
+    string log_file;
+    vector<string> logger_options;  // Passed through to the logger after its log file
+    string logger_path;      // Absolute, resolved once at startup
+    string encryption_path;
+    bool standby;            // Keep a prewarmed spare of each child
+    bool startup_stats;      // Report each child's time to first response
+    bool batch;              // Scripted commands in, one result record out per command
+    char delimiter;          // Ends each batch command and result record
+};
+
+vector<string> logger_args(const DriverOptions& options) {
+    vector<string> args = {"logger", options.log_file};
+    args.insert(args.end(), options.logger_options.begin(), options.logger_options.end());
+    args.push_back("--ack");
+    return args;
+}
+
+// The interactive session as a state machine driven by the event loop.
+// Every prompt becomes a state; input lines and encryption replies move
+// it along, so the driver never blocks on one pipe while another needs
+// attention.
+//
+// In batch mode there are no prompts: each input record is a whole command
+// ("encrypt attack at dawn") and each command produces one result record.
+// Encrypt/decrypt requests are pipelined to the encryption program; other
+// commands wait for them to finish, so results and history come out in
+// input order.
+class Driver {
+public:
+    Driver(HistoryStore& history, ResultCache& cache, const DriverOptions& options);
+    bool start();
+    int run();
+
+private:
+    enum State {
+        MENU,            // Waiting for a command
+        USE_HISTORY,     // "Use history? (y/n)"
+        SELECT_HISTORY,  // Picking an entry from a history page
+        ENTER_INPUT,     // Password or string to encrypt/decrypt
+        ENTER_MODE,      // Cipher name
+        HISTORY_MORE,    // Paging through the history command's output
+        AWAIT_REPLY      // Request sent to the encryption program
+    };
+
+    // A batch command that has been read but not reported yet
+    struct BatchRequest {
+        string operation;
+        string input;
+        string response;  // Reply once it arrives, as from the encryption program
+        bool done;
+        bool cache_hit;
+        bool rejected;    // Failed validation; nothing was sent
+    };
+
+    void log(const string& record);
+    void send_request(const string& request);
+    void fail_request(const string& reason);
+    void deliver_reply(const string& response);
+
+    void on_stdin(uint32_t events);
+    void on_encryption_output(uint32_t events);
+    void on_logger_output(uint32_t events);
+    void on_signal(uint32_t events);
+    void logger_started(Child& child, bool restarted);
+    void logger_exited(Child& child);
+    void encryption_started(Child& child, bool restarted);
+    void encryption_exited(Child& child);
+    void log_restart(const Supervisor& supervisor);
+    void child_ready(const Supervisor& supervisor, uint64_t startup_us);
+
+    void process_input();
+    void handle_line(const string& line);
+    void handle_command(string command);
+    void show_selection_page();
+    void begin_entry();
+    void submit(const string& input);
+    void handle_reply(const string& response);
+    void show_result(bool success, const string& text, const string& detail);
+    void finish_command();
+    void quit();
+    bool drained() const;
+
+    void process_batch();
+    void handle_batch_command(const string& line);
+    bool batch_blocked() const;
+    void complete_batch();
+    void emit(const string& record);
+
+    HistoryStore& history;
+    ResultCache& cache;
+    EventLoop loop;
+    OutputQueue logger_queue;
+    OutputQueue encrypt_queue;
+    LineReader input;
+    LineReader replies;
+    LineReader logger_acks;
+    Supervisor logger;
+    Supervisor encryption;
+    int signal_fd;
+    bool stdin_pollable;
+    bool startup_stats;
+    bool quitting;
+    deque<string> unacked;   // Records the logger has not acknowledged, resent after a restart
+    uint64_t logger_acked;   // Records the current logger has acknowledged
+
+    State state;
+    string operation;        // Command being carried out
+    string request_command;  // ENCRYPT/DECRYPT sent for it
+    string request_input;
+    bool cache_hit;          // Reply came from the cache, not the encryption program
+    deque<string> in_flight; // Requests awaiting replies, resent once after a restart
+    bool request_retried;
+    int replay_replies;      // Replies to PASS/MODE replayed into a restarted child
+    string password;         // Kept so a restarted encryption program gets the same key
+    string cipher_mode;
+    size_t page;
+
+    bool batch;
+    char delimiter;
+    deque<BatchRequest> outstanding;  // Batch commands in input order
+    string held_command;              // Waiting for outstanding to finish
+};
+
+Driver::Driver(HistoryStore& history, ResultCache& cache, const DriverOptions& options)
+    : history(history), cache(cache),
+      logger_queue(loop, "logger", MAX_QUEUED_BYTES),
+      encrypt_queue(loop, "encryption", MAX_QUEUED_BYTES),
+      input(options.delimiter),
+      logger(loop, "logger", options.logger_path, logger_args(options), true,
+             options.standby, "LOGGER_READY_FD", {"--standby"}),
+      encryption(loop, "encryption", options.encryption_path, {"encryption"}, true, options.standby),
+      signal_fd(-1), stdin_pollable(true), startup_stats(options.startup_stats), quitting(false),
+      logger_acked(0),
+      state(MENU), cache_hit(false), request_retried(false), replay_replies(0),
+      cipher_mode("VIGENERE"), page(0), batch(options.batch), delimiter(options.delimiter) {}
+
+bool Driver::start() {
+    // Child exits arrive on a signalfd instead of interrupting the loop;
+    // a vanished reader shows up as EPIPE instead of killing the driver
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd == -1) {
+        perror("signalfd failed");
+        return false;
     }
-    
-    string log_file = argv[1];
-    vector<string> history;
-    
-    // Pipes for logger
-    int logger_pipe[2];
-    if (pipe(logger_pipe) == -1) {
-        perror("Logger pipe creation failed");
-        return 1;
+    loop.add(signal_fd, EPOLLIN, [this](uint32_t events) { on_signal(events); });
+
+    logger.on_ready([this](Child&, uint64_t startup_us) { child_ready(logger, startup_us); });
+    encryption.on_ready([this](Child&, uint64_t startup_us) { child_ready(encryption, startup_us); });
+
+    bool started = logger.start([this](Child& child, bool restarted) { logger_started(child, restarted); },
+                                [this](Child& child) { logger_exited(child); });
+    if (!started) {
+        perror("Logger start failed");
+        return false;
     }
-    
-    // Pipes for encryption program
-    int encrypt_in_pipe[2];  // Driver writes to encryption
-    int encrypt_out_pipe[2]; // Driver reads from encryption
-    
-    if (pipe(encrypt_in_pipe) == -1 || pipe(encrypt_out_pipe) == -1) {
-        perror("Encryption pipe creation failed");
-        return 1;
+
+    started = encryption.start([this](Child& child, bool restarted) { encryption_started(child, restarted); },
+                               [this](Child& child) { encryption_exited(child); });
+    if (!started) {
+        perror("Encryption start failed");
+        return false;
     }
-    
-    // Fork for logger
-    pid_t logger_pid = fork();
-    
-    if (logger_pid == -1) {
-        perror("Logger fork failed");
-        return 1;
+
+    // epoll refuses regular files; a redirected file is read directly instead
+    stdin_pollable = loop.add(STDIN_FILENO, EPOLLIN, [this](uint32_t events) { on_stdin(events); });
+    return true;
+}
+
+void Driver::log(const string& record) {
+    // Kept until acknowledged unless the queue dropped it; a broken pipe
+    // means the logger is exiting and its replacement gets the record
+    if (logger_queue.write(record + "\n") || logger_queue.broken()) {
+        unacked.push_back(record);
     }
-    
-    if (logger_pid == 0) {  // Logger child process
-        // Redirect stdin to read from pipe
-        close(logger_pipe[1]);  // Close write end
-        dup2(logger_pipe[0], STDIN_FILENO);
-        close(logger_pipe[0]);
-        
-        // Execute logger program
-        execlp("./logger", "logger", log_file.c_str(), NULL);
-        
-        // If execlp returns, it failed
-        perror("Logger execution failed");
-        exit(1);
-    }
-    
-    // Close read end of logger pipe in parent
-    close(logger_pipe[0]);
-    
-    // Fork for encryption program
-    pid_t encrypt_pid = fork();
-    
-    if (encrypt_pid == -1) {
-        perror("Encryption fork failed");
-        return 1;
+}
+
+void Driver::send_request(const string& request) {
+    if (!batch) {
+        state = AWAIT_REPLY;
     }
-    
-    if (encrypt_pid == 0) {  // Encryption child process
-        // Redirect stdin to read from pipe
-        close(encrypt_in_pipe[1]);  // Close write end
-        dup2(encrypt_in_pipe[0], STDIN_FILENO);
-        close(encrypt_in_pipe[0]);
-        
-        // Redirect stdout to write to pipe
-        close(encrypt_out_pipe[0]);  // Close read end
-        dup2(encrypt_out_pipe[1], STDOUT_FILENO);
-        close(encrypt_out_pipe[1]);
-        
-        // Execute encryption program
-        execlp("./encryption", "encryption", NULL);
-        
-        // If execlp returns, it failed
-        perror("Encryption execution failed");
-        exit(1);
-    }
-    
-    // Close unused pipe ends in parent
-    close(encrypt_in_pipe[0]);
-    close(encrypt_out_pipe[1]);
-    
-    // Log the start of the driver program
-    string start_log = "START Driver program started";
-    write_to_pipe(logger_pipe[1], start_log + "\n");
-    
-    bool running = true;
-    while (running) {
-        display_menu();
-        
-        string command;
-        getline(cin, command);
-        
-        // Convert command to lowercase
-        transform(command.begin(), command.end(), command.begin(), ::tolower);
-        
-        // Log the command
-        string command_log = "COMMAND User entered: " + command;
-        write_to_pipe(logger_pipe[1], command_log + "\n");
-        
-        if (command == "password") {
-            string password;
-            bool use_history = false;
-            
-            if (!history.empty()) {
-                cout << "Use history? (y/n): ";
-                string response;
-                getline(cin, response);
-                
-                if (response == "y" || response == "Y") {
-                    use_history = true;
-                    cout << "\n=== History ===\n";
-                    for (size_t i = 0; i < history.size(); i++) {
-                        cout << i + 1 << ". " << history[i] << "\n";
-                    }
-                    cout << "0. Enter new password\n";
-                    cout << "Enter selection: ";
-                    
-                    int selection;
-                    cin >> selection;
-                    cin.ignore(); // Clear newline
-                    
-                    if (selection > 0 && selection <= static_cast<int>(history.size())) {
-                        password = history[selection - 1];
-                    } else {
-                        use_history = false;
-                    }
-                }
+    in_flight.push_back(request);
+
+    if (encryption.restarting()) {
+        return;  // Sent once the replacement is up
+    }
+    if (!encryption.running()) {
+        fail_request("Encryption program is not running");
+        return;
+    }
+    // A broken pipe means the child is exiting; the restart resends the request
+    if (!encrypt_queue.write(request) && !encrypt_queue.broken()) {
+        fail_request("Encryption request dropped");
+    }
+}
+
+// Fails every request still awaiting a reply
+void Driver::fail_request(const string& reason) {
+    log("ERROR " + reason);
+    request_retried = false;
+    while (!in_flight.empty()) {
+        in_flight.pop_front();
+        deliver_reply("ERROR " + reason + "\n");
+    }
+}
+
+void Driver::deliver_reply(const string& response) {
+    if (!batch) {
+        handle_reply(response);
+        return;
+    }
+    // Replies come back in the order the requests were sent
+    for (BatchRequest& request : outstanding) {
+        if (!request.done) {
+            request.response = response;
+            request.done = true;
+            break;
+        }
+    }
+    complete_batch();
+}
+
+void Driver::on_stdin(uint32_t) {
+    if (!input.read_from(STDIN_FILENO)) {
+        loop.remove(STDIN_FILENO);
+    }
+}
+
+void Driver::on_encryption_output(uint32_t) {
+    int fd = encryption.active().out_fd;
+    if (!replies.read_from(fd)) {
+        // The exit itself is handled when SIGCHLD arrives
+        loop.remove(fd);
+        return;
+    }
+
+    string response;
+    while (replies.next_line(response)) {
+        if (response == "PONG") {
+            encryption.mark_ready();
+        } else if (replay_replies > 0) {
+            replay_replies--;
+            if (response.compare(0, 6, "RESULT") != 0) {
+                log("ERROR Replay into restarted encryption program failed: " + response);
             }
-            
-            if (!use_history) {
-                cout << "Enter password (letters only): ";
-                getline(cin, password);
-                
+        } else if (!in_flight.empty()) {
+            in_flight.pop_front();
+            request_retried = false;  // The child is making progress
+            deliver_reply(response + "\n");
+        } else {
+            // Nothing was asked; report it rather than pairing it with a later request
+            log("ERROR Unexpected encryption output: " + response);
+        }
+    }
+}
+
+void Driver::on_logger_output(uint32_t) {
+    int fd = logger.active().out_fd;
+    if (!logger_acks.read_from(fd)) {
+        loop.remove(fd);
+        return;
+    }
+
+    string line;
+    while (logger_acks.next_line(line)) {
+        if (line.compare(0, 4, "ACK ") != 0) {
+            continue;
+        }
+        uint64_t written = strtoull(line.c_str() + 4, NULL, 10);
+        while (logger_acked < written && !unacked.empty()) {
+            unacked.pop_front();
+            logger_acked++;
+        }
+    }
+}
+
+void Driver::on_signal(uint32_t) {
+    struct signalfd_siginfo info;
+    while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+    }
+
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        string how = WIFEXITED(status) ? "exited with status " + to_string(WEXITSTATUS(status))
+                                       : "was killed by signal " + to_string(WTERMSIG(status));
+        if (!quitting && pid == logger.active().pid) {
+            log("ERROR Logger program " + how);
+        } else if (!quitting && pid == encryption.active().pid) {
+            log("ERROR Encryption program " + how);
+        }
+        if (!logger.child_exited(pid)) {
+            encryption.child_exited(pid);
+        }
+    }
+}
+
+void Driver::logger_started(Child& child, bool restarted) {
+    set_nonblocking(child.out_fd);
+    loop.add(child.out_fd, EPOLLIN, [this](uint32_t events) { on_logger_output(events); });
+    logger_acked = 0;
+    if (!restarted) {
+        logger_queue.attach(child.in_fd);
+        return;
+    }
+
+    // Everything the dead logger did not acknowledge goes to its
+    // replacement: what was queued while it was down and what was still
+    // in its pipe. A record it wrote just before dying, but had not yet
+    // acknowledged, is written twice.
+    deque<string> resend;
+    resend.swap(unacked);
+    logger_queue.clear();
+    logger_queue.attach(child.in_fd);
+    for (const string& record : resend) {
+        log(record);
+    }
+    log_restart(logger);
+}
+
+void Driver::logger_exited(Child& child) {
+    loop.remove(child.out_fd);
+    logger_queue.detach();
+    logger_acks.clear();
+}
+
+void Driver::encryption_started(Child& child, bool restarted) {
+    encrypt_queue.attach(child.in_fd);
+    set_nonblocking(child.out_fd);
+    loop.add(child.out_fd, EPOLLIN, [this](uint32_t events) { on_encryption_output(events); });
+    if (startup_stats) {
+        // The PONG marks the first response
+        encrypt_queue.write("PING\n");
+    }
+    if (!restarted) {
+        return;
+    }
+    log_restart(encryption);
+
+    // Bring the new process back to the session's key and cipher
+    if (!password.empty()) {
+        encrypt_queue.write("PASS " + password + "\n");
+        replay_replies++;
+    }
+    if (cipher_mode != "VIGENERE") {
+        encrypt_queue.write("MODE " + cipher_mode + "\n");
+        replay_replies++;
+    }
+    for (const string& request : in_flight) {
+        encrypt_queue.write(request);
+    }
+}
+
+void Driver::encryption_exited(Child& child) {
+    loop.remove(child.out_fd);
+    encrypt_queue.detach();
+    encrypt_queue.clear();
+    replies.clear();
+    replay_replies = 0;
+    if (quitting || in_flight.empty()) {
+        return;
+    }
+
+    // Retry once; a request that kills the replacement too is reported
+    if (request_retried || encryption.gave_up()) {
+        fail_request("Encryption program exited while handling the request");
+    } else {
+        request_retried = true;
+    }
+}
+
+void Driver::log_restart(const Supervisor& supervisor) {
+    log(string("RESTART ") + supervisor.name() +
+        " restarts=" + to_string(supervisor.restarts()) +
+        " downtime_us=" + to_string(supervisor.last_downtime_us()) +
+        " total_downtime_us=" + to_string(supervisor.total_downtime_us()) +
+        (supervisor.last_from_standby() ? " standby" : ""));
+}
+
+void Driver::child_ready(const Supervisor& supervisor, uint64_t startup_us) {
+    if (!startup_stats) {
+        return;
+    }
+    cerr << "startup: " << supervisor.name() << " first response after " << startup_us << " us\n";
+    log(string("INFO Startup ") + supervisor.name() + " first_response_us=" + to_string(startup_us));
+}
+
+void Driver::process_input() {
+    if (batch) {
+        process_batch();
+        return;
+    }
+
+    string line;
+    while (state != AWAIT_REPLY && !quitting) {
+        if (!input.next_line(line)) {
+            if (input.eof()) {
+                // End of input behaves like quit
+                cout << "\n";
+                quit();
+            }
+            return;
+        }
+        handle_line(line);
+    }
+}
+
+void Driver::handle_line(const string& line) {
+    switch (state) {
+        case MENU:
+            handle_command(line);
+            break;
+
+        case USE_HISTORY:
+            if (line == "y" || line == "Y") {
+                page = history_pages(history) - 1;  // Most recent entries first
+                show_selection_page();
+            } else {
+                begin_entry();
+            }
+            break;
+
+        case SELECT_HISTORY: {
+            size_t pages = history_pages(history);
+            if (line == "n" || line == "N") {
+                page = (page + 1) % pages;
+                show_selection_page();
+                break;
+            }
+            if (line == "p" || line == "P") {
+                page = (page + pages - 1) % pages;
+                show_selection_page();
+                break;
+            }
+
+            int selection = atoi(line.c_str());
+            if (selection > 0 && selection <= static_cast<int>(history.size())) {
+                string selected = history.at(selection - 1);
+                history.touch(selection - 1);
+                submit(selected);
+            } else {
+                begin_entry();
+            }
+            break;
+        }
+
+        case ENTER_INPUT: {
+            if (operation == "password") {
                 // Validate password (letters only)
-                if (!is_alpha_only(password)) {
+                if (!is_alpha_only(line)) {
                     cout << "Error: Password must contain only letters\n";
-                    continue;
+                    finish_command();
+                    break;
                 }
+            } else {
+                // Validate input (letters only, or hex for binary ciphertext)
+                bool hex_input = operation == "decrypt" && cipher_mode != "VIGENERE";
+                if (hex_input ? !is_hex_only(line) : !is_alpha_only(line)) {
+                    cout << (hex_input ? "Error: String must be hexadecimal\n" : "Error: String must contain only letters\n");
+                    finish_command();
+                    break;
+                }
+
+                // Add to history
+                history.append(line);
             }
-            
-            // Send password to encryption program
-            string pass_command = "PASS " + password + "\n";
-            write_to_pipe(encrypt_in_pipe[1], pass_command);
-            
-            // Read response
-            string response = read_from_pipe(encrypt_out_pipe[0]);
-            
-            // Log the result (don't log the actual password)
-            string result_log = "RESULT Password set";
-            write_to_pipe(logger_pipe[1], result_log + "\n");
-            
-            cout << "Password set successfully\n";
+            submit(line);
+            break;
         }
-        else if (command == "encrypt" || command == "decrypt") {
-            string input_string;
-            bool use_history = false;
-            
-            if (!history.empty()) {
-                cout << "Use history? (y/n): ";
-                string response;
-                getline(cin, response);
-                
-                if (response == "y" || response == "Y") {
-                    use_history = true;
-                    cout << "\n=== History ===\n";
-                    for (size_t i = 0; i < history.size(); i++) {
-                        cout << i + 1 << ". " << history[i] << "\n";
-                    }
-                    cout << "0. Enter new string\n";
-                    cout << "Enter selection: ";
-                    
-                    int selection;
-                    cin >> selection;
-                    cin.ignore(); // Clear newline
-                    
-                    if (selection > 0 && selection <= static_cast<int>(history.size())) {
-                        input_string = history[selection - 1];
-                    } else {
-                        use_history = false;
-                    }
-                }
+
+        case ENTER_MODE: {
+            // An empty MODE only asks for the current cipher
+            if (line.empty()) {
+                cout << "Error: Cipher name is required\n";
+                finish_command();
+                break;
             }
-            
-            if (!use_history) {
-                cout << "Enter string (letters only): ";
-                getline(cin, input_string);
-                
-                // Validate input (letters only)
-                if (!is_alpha_only(input_string)) {
-                    cout << "Error: String must contain only letters\n";
-                    continue;
-                }
-                
-                // Add to history
-                history.push_back(input_string);
+            string mode = line;
+            transform(mode.begin(), mode.end(), mode.begin(), ::toupper);
+            request_input = mode;
+            send_request("MODE " + mode + "\n");
+            break;
+        }
+
+        case HISTORY_MORE:
+            if (line == "q" || line == "Q" || ++page >= history_pages(history)) {
+                log("INFO History displayed");
+                finish_command();
+                break;
             }
-            
-            // Convert command to uppercase for encryption program
-            string encrypt_command = command;
-            transform(encrypt_command.begin(), encrypt_command.end(), encrypt_command.begin(), ::toupper);
-            
-            // Send command to encryption program
-            string full_command = encrypt_command + " " + input_string + "\n";
-            write_to_pipe(encrypt_in_pipe[1], full_command);
-            
-            // Read response
-            string response = read_from_pipe(encrypt_out_pipe[0]);
-            
-            // Display and log the result
-            cout << response;
-            
-            // Parse the response to extract result type and message
-            size_t space_pos = response.find(' ');
-            string result_type = response.substr(0, space_pos);
-            string result_message = "";
-            
-            if (space_pos != string::npos) {
-                result_message = response.substr(space_pos + 1);
-                // Remove newline if present
-                if (!result_message.empty() && result_message.back() == '\n') {
-                    result_message.pop_back();
-                }
-                
-                // Add to history if operation was successful
-                if (result_type == "RESULT") {
-                    history.push_back(result_message);
-                }
+            display_history_page(history, page);
+            if (page + 1 < history_pages(history)) {
+                cout << "-- More (Enter to continue, q to stop): ";
+            } else {
+                log("INFO History displayed");
+                finish_command();
             }
-            
-            // Log the result
-            string result_log = result_type + " " + encrypt_command + " operation: " + result_message;
-            write_to_pipe(logger_pipe[1], result_log + "\n");
+            break;
+
+        case AWAIT_REPLY:
+            break;
+    }
+}
+
+void Driver::handle_command(string command) {
+    // Convert command to lowercase
+    transform(command.begin(), command.end(), command.begin(), ::tolower);
+
+    // Log the command
+    log("COMMAND User entered: " + command);
+    operation = command;
+
+    if (command == "password" || command == "encrypt" || command == "decrypt") {
+        if (!history.empty()) {
+            cout << "Use history? (y/n): ";
+            state = USE_HISTORY;
+        } else {
+            begin_entry();
         }
-        else if (command == "history") {
-            if (history.empty()) {
-                cout << "History is empty\n";
+    }
+    else if (command == "mode") {
+        cout << "Enter cipher (vigenere/chacha20): ";
+        state = ENTER_MODE;
+    }
+    else if (command == "history") {
+        if (history.empty()) {
+            cout << "History is empty\n";
+            log("INFO History displayed");
+            finish_command();
+        } else {
+            // Page through large histories instead of printing everything
+            page = 0;
+            display_history_page(history, page);
+            if (history_pages(history) > 1) {
+                cout << "-- More (Enter to continue, q to stop): ";
+                state = HISTORY_MORE;
             } else {
-                cout << "\n=== History ===\n";
-                for (size_t i = 0; i < history.size(); i++) {
-                    cout << i + 1 << ". " << history[i] << "\n";
-                }
+                log("INFO History displayed");
+                finish_command();
             }
-            
-            // Log the history display
-            string history_log = "INFO History displayed";
-            write_to_pipe(logger_pipe[1], history_log + "\n");
         }
-        else if (command == "quit") {
-            running = false;
-            
-            // Send QUIT to encryption program
-            write_to_pipe(encrypt_in_pipe[1], "QUIT\n");
-            
-            // Send QUIT to logger
-            write_to_pipe(logger_pipe[1], "QUIT\n");
-            
-            // Log the exit
-            string exit_log = "EXIT Driver program exiting";
-            write_to_pipe(logger_pipe[1], exit_log + "\n");
-            
-            cout << "Exiting...\n";
+    }
+    else if (command == "quit") {
+        quit();
+    }
+    else {
+        cout << "Unknown command\n";
+
+        // Log the unknown command
+        log("ERROR Unknown command: " + command);
+        finish_command();
+    }
+}
+
+void Driver::show_selection_page() {
+    display_history_page(history, page);
+    cout << "0. " << (operation == "password" ? "Enter new password" : "Enter new string") << "\n";
+    if (history_pages(history) > 1) {
+        cout << "(n - next page, p - previous page)\n";
+    }
+    cout << "Enter selection: ";
+    state = SELECT_HISTORY;
+}
+
+void Driver::begin_entry() {
+    if (operation == "password") {
+        cout << "Enter password (letters only): ";
+    } else {
+        // Binary cipher modes decrypt hex ciphertext rather than letters
+        bool hex_input = operation == "decrypt" && cipher_mode != "VIGENERE";
+        cout << (hex_input ? "Enter string (hex): " : "Enter string (letters only): ");
+    }
+    state = ENTER_INPUT;
+}
+
+void Driver::submit(const string& input) {
+    request_input = input;
+
+    if (operation == "password") {
+        // Send password to encryption program
+        send_request("PASS " + input + "\n");
+        return;
+    }
+
+    // Convert command to uppercase for encryption program
+    request_command = operation;
+    transform(request_command.begin(), request_command.end(), request_command.begin(), ::toupper);
+
+    // Answer from the cache when this exact request was seen under the current key
+    string response;
+    cache_hit = cache.lookup(request_command, input, response);
+    if (cache_hit) {
+        state = AWAIT_REPLY;
+        handle_reply(response);
+        return;
+    }
+    send_request(request_command + " " + input + "\n");
+}
+
+void Driver::handle_reply(const string& response) {
+    bool success = response.compare(0, 6, "RESULT") == 0;
+
+    if (operation == "password") {
+        if (success) {
+            // Cached results belong to the old key
+            cache.set_key(request_input);
+            password = request_input;
+
+            // Log the result (don't log the actual password)
+            log("RESULT Password set");
+            show_result(true, "Password set successfully\n", "");
+        } else {
+            log("ERROR Password not set");
+            show_result(false, response, response.substr(response.find(' ') + 1));
         }
-        else {
-            cout << "Unknown command\n";
-            
-            // Log the unknown command
-            string unknown_log = "ERROR Unknown command: " + command;
-            write_to_pipe(logger_pipe[1], unknown_log + "\n");
+    }
+    else if (operation == "mode") {
+        if (success) {
+            // The reply names the engine now in use ("RESULT CHACHA20")
+            cipher_mode = response.size() > 7 ? response.substr(7) : request_input;
+            cipher_mode.erase(cipher_mode.find_last_not_of("\n") + 1);
+            // Cached results were produced by the previous cipher
+            cache.clear();
+            show_result(true, "Cipher set to " + cipher_mode + "\n", cipher_mode);
+            log("RESULT Cipher set to " + cipher_mode);
+        } else {
+            show_result(false, "Error: Unknown cipher\n", "Unknown cipher");
+            log("ERROR Unknown cipher: " + request_input);
         }
     }
-    
-    // Close pipes
-    close(encrypt_in_pipe[1]);
-    close(encrypt_out_pipe[0]);
-    close(logger_pipe[1]);
-    
-    // Wait for child processes to terminate
-    waitpid(logger_pid, NULL, 0);
-    waitpid(encrypt_pid, NULL, 0);
-    
+    else {
+        if (!cache_hit && success) {
+            cache.store(request_command, request_input, response);
+        }
+        log(string("CACHE ") + (cache_hit ? "hit " : "miss ") + cache.stats());
+
+        // Parse the response to extract result type and message
+        size_t space_pos = response.find(' ');
+        string result_type = response.substr(0, space_pos);
+        string result_message = "";
+
+        if (space_pos != string::npos) {
+            result_message = response.substr(space_pos + 1);
+            // Remove newline if present
+            if (!result_message.empty() && result_message.back() == '\n') {
+                result_message.pop_back();
+            }
+        }
+
+        // Display and log the result
+        show_result(success, response, result_message);
+
+        if (space_pos != string::npos) {
+
+            // Add to history if operation was successful
+            if (result_type == "RESULT") {
+                history.append(result_message);
+            }
+        }
+
+        // Log the result
+        log(result_type + " " + request_command + " operation: " + result_message);
+    }
+
+    finish_command();
+}
+
+// Shows text at the menu, or a result record in batch mode
+void Driver::show_result(bool success, const string& text, const string& detail) {
+    if (!batch) {
+        cout << text;
+        return;
+    }
+    string record = string(success ? "OK " : "ERROR ") + operation;
+    if (!detail.empty()) {
+        record += " " + detail;
+    }
+    // Replies from the encryption program carry their own newline
+    if (!record.empty() && record.back() == '\n') {
+        record.pop_back();
+    }
+    emit(record);
+}
+
+void Driver::finish_command() {
+    state = MENU;
+    if (!quitting && !batch) {
+        display_menu();
+    }
+}
+
+void Driver::quit() {
+    // A child that died before the quit is handled while its supervisor
+    // can still replace it
+    on_signal(0);
+    quitting = true;
+    encryption.stop();
+
+    // Send QUIT to encryption program
+    encrypt_queue.write("QUIT\n");
+
+    // Log the exit. The logger keeps its standby and restarts until every
+    // record is acknowledged; shutdown then closes its stdin.
+    log("EXIT Driver program exiting");
+
+    if (!batch) {
+        cout << "Exiting...\n";
+    }
+}
+
+bool Driver::drained() const {
+    return (unacked.empty() || logger.gave_up()) &&
+           (encrypt_queue.empty() || encrypt_queue.broken() || !encryption.running());
+}
+
+void Driver::process_batch() {
+    string line;
+    while (!quitting) {
+        if (!held_command.empty()) {
+            if (!outstanding.empty()) {
+                return;
+            }
+            line.swap(held_command);
+            held_command.clear();
+            handle_batch_command(line);
+            continue;
+        }
+        if (batch_blocked()) {
+            return;
+        }
+        if (!input.next_line(line)) {
+            // End of input behaves like quit once every result is out
+            if (input.eof() && outstanding.empty()) {
+                quit();
+            }
+            return;
+        }
+        handle_batch_command(line);
+    }
+}
+
+// True while no further command can be taken from the input
+bool Driver::batch_blocked() const {
+    if (!held_command.empty() || outstanding.size() >= BATCH_WINDOW) {
+        return true;
+    }
+    // A password or mode change affects how later requests are checked and cached
+    return !outstanding.empty() && outstanding.front().operation != "encrypt" &&
+           outstanding.front().operation != "decrypt";
+}
+
+void Driver::handle_batch_command(const string& line) {
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start == string::npos) {
+        return;  // Blank records are skipped
+    }
+    size_t space = line.find(' ', start);
+    string command = line.substr(start, space == string::npos ? string::npos : space - start);
+    string argument = space == string::npos ? "" : line.substr(space + 1);
+    transform(command.begin(), command.end(), command.begin(), ::tolower);
+
+    // Everything but encrypt/decrypt sees the results of earlier commands first
+    bool request = command == "encrypt" || command == "decrypt";
+    if (!request && !outstanding.empty()) {
+        held_command = line;
+        return;
+    }
+
+    log("COMMAND User entered: " + command);
+    operation = command;
+
+    // The encryption program reads one request per line
+    if (argument.find('\n') != string::npos) {
+        if (request) {
+            outstanding.push_back({command, argument, "Input must not contain newlines", true, false, true});
+            complete_batch();
+        } else {
+            show_result(false, "", "Input must not contain newlines");
+        }
+        return;
+    }
+
+    if (request) {
+        BatchRequest entry = {command, argument, "", false, false, false};
+        string upper = command;
+        transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
+        bool hex_input = command == "decrypt" && cipher_mode != "VIGENERE";
+        if (hex_input ? !is_hex_only(argument) : !is_alpha_only(argument)) {
+            entry.response = hex_input ? "String must be hexadecimal" : "String must contain only letters";
+            entry.done = true;
+            entry.rejected = true;
+        } else {
+            entry.cache_hit = cache.lookup(upper, argument, entry.response);
+            entry.done = entry.cache_hit;
+        }
+        outstanding.push_back(entry);
+        if (!entry.done) {
+            send_request(upper + " " + argument + "\n");
+        }
+        complete_batch();
+    }
+    else if (command == "password") {
+        if (!is_alpha_only(argument)) {
+            show_result(false, "", "Password must contain only letters");
+            return;
+        }
+        outstanding.push_back({command, argument, "", false, false, false});
+        send_request("PASS " + argument + "\n");
+    }
+    else if (command == "mode") {
+        if (argument.empty()) {
+            show_result(false, "", "Cipher name is required");
+            return;
+        }
+        transform(argument.begin(), argument.end(), argument.begin(), ::toupper);
+        outstanding.push_back({command, argument, "", false, false, false});
+        send_request("MODE " + argument + "\n");
+    }
+    else if (command == "history") {
+        // "history <n>" lists only the n most recent entries
+        size_t count = argument.empty() ? history.size() : min<size_t>(strtoul(argument.c_str(), NULL, 10), history.size());
+        for (size_t i = history.size() - count; i < history.size(); i++) {
+            emit("HISTORY " + history.at(i));
+        }
+        log("INFO History displayed");
+        show_result(true, "", to_string(history.size()));
+    }
+    else if (command == "quit") {
+        quit();
+    }
+    else {
+        show_result(false, "", "Unknown command");
+        log("ERROR Unknown command: " + command);
+    }
+}
+
+// Reports finished batch commands from the front, keeping input order
+void Driver::complete_batch() {
+    while (!outstanding.empty() && outstanding.front().done) {
+        BatchRequest request = outstanding.front();
+        outstanding.pop_front();
+        operation = request.operation;
+        if (request.rejected) {
+            show_result(false, "", request.response);
+            continue;
+        }
+
+        request_input = request.input;
+        request_command = operation;
+        transform(request_command.begin(), request_command.end(), request_command.begin(), ::toupper);
+        cache_hit = request.cache_hit;
+        if (request_command == "ENCRYPT" || request_command == "DECRYPT") {
+            history.append(request.input);
+        }
+        handle_reply(request.response);
+    }
+}
+
+void Driver::emit(const string& record) {
+    cout << record << delimiter;
+}
+
+int Driver::run() {
+    // Log the start of the driver program
+    log("START Driver program started");
+    if (!batch) {
+        display_menu();
+    }
+
+    while (!quitting || !drained()) {
+        process_input();
+        cout.flush();
+
+        bool waiting = batch ? batch_blocked() : state == AWAIT_REPLY;
+        if (!quitting && !stdin_pollable && !waiting && !input.eof() && !input.has_line()) {
+            // Regular-file stdin never blocks for long; read it directly
+            input.read_from(STDIN_FILENO);
+            loop.run_once(0);
+            continue;
+        }
+        loop.run_once(quitting ? 100 : -1);
+    }
+
+    logger_queue.detach();
+    encrypt_queue.detach();
+    if (logger.running()) {
+        loop.remove(logger.active().out_fd);
+    }
+    if (encryption.running()) {
+        loop.remove(encryption.active().out_fd);
+    }
+
+    // Close pipes and wait for child processes to terminate
+    logger.shutdown();
+    encryption.shutdown();
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char* argv[]) {
+    TRACE_INIT("driver");
+
+    // Ensure log file name is provided
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <log_file_name> [--history-file <file>] [--history-cap <n>] [--cache-bytes <n>] [--standby] [--startup-stats] [--batch <file|->] [--null] [-- <logger options>]\n";
+        return 1;
+    }
+
+    string log_file = argv[1];
+    string history_file = log_file + ".history";
+    size_t history_cap = 0;
+    size_t cache_bytes = 1024 * 1024;
+    DriverOptions options;
+    options.log_file = log_file;
+    options.standby = false;
+    options.startup_stats = false;
+    options.batch = false;
+    options.delimiter = '\n';
+    string batch_file;
+
+    for (int i = 2; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--history-file" && i + 1 < argc) {
+            history_file = argv[++i];
+        } else if (option == "--history-cap" && i + 1 < argc) {
+            history_cap = strtoul(argv[++i], NULL, 10);
+        } else if (option == "--cache-bytes" && i + 1 < argc) {
+            cache_bytes = strtoul(argv[++i], NULL, 10);
+        } else if (option == "--standby") {
+            options.standby = true;
+        } else if (option == "--startup-stats") {
+            options.startup_stats = true;
+        } else if (option == "--batch" && i + 1 < argc) {
+            options.batch = true;
+            batch_file = argv[++i];
+        } else if (option == "--null") {
+            options.delimiter = '\0';
+        } else if (option == "--") {
+            // Everything after -- is for the logger (rotation and retention)
+            options.logger_options.assign(argv + i + 1, argv + argc);
+            break;
+        } else {
+            cerr << "Unknown option: " << option << "\n";
+            return 1;
+        }
+    }
+
+    if (options.batch) {
+        // Results are written in bulk, not per command
+        ios::sync_with_stdio(false);
+        if (batch_file != "-") {
+            int fd = open(batch_file.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd == -1 || dup2(fd, STDIN_FILENO) == -1) {
+                cerr << "Error: Unable to open batch file " << batch_file << "\n";
+                return 1;
+            }
+            close(fd);
+        }
+    }
+
+    // History survives restarts; entries are mapped in, not parsed
+    HistoryStore history;
+    if (!history.open(history_file, history_cap)) {
+        cerr << "Error: Unable to open history file " << history_file << "\n";
+        return 1;
+    }
+
+    // Replies for repeated encrypt/decrypt requests under the current key
+    ResultCache cache(cache_bytes);
+
+    // Restarts launch the same binaries even if the working directory changes
+    options.logger_path = resolve_program("./logger");
+    options.encryption_path = resolve_program("./encryption");
+    if (options.logger_path.empty() || options.encryption_path.empty()) {
+        cerr << "Error: ./logger and ./encryption must be executable programs\n";
+        return 1;
+    }
+
+    // Children that die are restarted; --standby keeps a spare of each ready
+    Driver driver(history, cache, options);
+    if (!driver.start()) {
+        return 1;
+    }
+    int status = driver.run();
+
+    history.close();
+    return status;
+}
@@ -0,0 +1,578 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+// A reply that takes longer than this means the pipeline is stuck
+const int REPLY_TIMEOUT_MS = 10000;
+
+// Batch commands in flight unless --window says otherwise
+const size_t DEFAULT_WINDOW = 64;
+
+// Histogram buckets are powers of two in microseconds, up to ~67 s
+const int HISTOGRAM_BUCKETS = 27;
+
+// One scripted command: "encrypt attack", "password key", "history"...
+struct Command {
+    string name;
+    string argument;
+};
+
+// Latencies of one kind of command, in nanoseconds
+struct Samples {
+    vector<uint64_t> latencies;
+    size_t errors = 0;
+};
+
+bool parse_command(const string& line, Command& command) {
+    size_t start = line.find_first_not_of(" \t");
+    if (start == string::npos || line[start] == '#') {
+        return false;
+    }
+    size_t space = line.find(' ', start);
+    command.name = line.substr(start, space == string::npos ? string::npos : space - start);
+    command.argument = space == string::npos ? "" : line.substr(space + 1);
+    transform(command.name.begin(), command.name.end(), command.name.begin(), ::tolower);
+    return true;
+}
+
+bool read_script(const string& path, vector<Command>& commands) {
+    ifstream file;
+    if (path != "-") {
+        file.open(path);
+        if (!file.is_open()) {
+            cerr << "Error: Unable to open script " << path << "\n";
+            return false;
+        }
+    }
+    istream& in = path == "-" ? cin : file;
+    string line;
+    Command command;
+    while (getline(in, line)) {
+        if (parse_command(line, command)) {
+            commands.push_back(command);
+        }
+    }
+    return true;
+}
+
+string random_letters(mt19937& rng, size_t length) {
+    string text(length, 'a');
+    for (char& c : text) {
+        c = 'a' + rng() % 26;
+    }
+    return text;
+}
+
+// A session mix: mostly encrypt/decrypt over a small pool of strings (so the
+// driver's result cache sees repeats), with occasional key changes and
+// history listings
+vector<Command> generate_commands(size_t count, unsigned seed) {
+    mt19937 rng(seed);
+    vector<string> words;
+    for (int i = 0; i < 64; i++) {
+        words.push_back(random_letters(rng, 4 + rng() % 21));
+    }
+    vector<string> keys = {"secretkey", "lemon", "attackatdawn", "passphrase"};
+
+    vector<Command> commands;
+    commands.push_back({"password", keys[0]});
+    while (commands.size() < count) {
+        unsigned roll = rng() % 100;
+        if (roll < 50) {
+            commands.push_back({"encrypt", words[rng() % words.size()]});
+        } else if (roll < 85) {
+            commands.push_back({"decrypt", words[rng() % words.size()]});
+        } else if (roll < 95) {
+            commands.push_back({"password", keys[rng() % keys.size()]});
+        } else {
+            // Batch mode lists only this many; the menu shows one page
+            commands.push_back({"history", "20"});
+        }
+    }
+    return commands;
+}
+
+// The driver's stdin/stdout, answered the way a user at the menu would
+class DriverSession {
+public:
+    DriverSession() : pid(-1), to_driver(-1), from_driver(-1) {}
+
+    bool start(const vector<string>& args, bool batch);
+    // Runs one command to the next menu prompt; false if the driver stopped answering
+    bool run(const Command& command, bool& failed);
+    // Streams the commands into a --batch driver, at most `window` ahead
+    // of the results read back
+    bool run_batch(const vector<Command>& commands, size_t window,
+                   vector<uint64_t>& latencies, vector<bool>& failed);
+    int finish();
+
+private:
+    bool send(const string& line);
+    // Reads until the output ends with a prompt, which is returned
+    bool wait_prompt(string& prompt);
+
+    pid_t pid;
+    int to_driver;
+    int from_driver;
+    string output;
+};
+
+bool DriverSession::start(const vector<string>& args, bool batch) {
+    int in_pipe[2], out_pipe[2];
+    if (pipe(in_pipe) == -1 || pipe(out_pipe) == -1) {
+        perror("pipe failed");
+        return false;
+    }
+
+    pid = fork();
+    if (pid == -1) {
+        perror("fork failed");
+        return false;
+    }
+    if (pid == 0) {
+        dup2(in_pipe[0], STDIN_FILENO);
+        dup2(out_pipe[1], STDOUT_FILENO);
+        close(in_pipe[0]);
+        close(in_pipe[1]);
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+
+        vector<char*> argv;
+        for (const string& arg : args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(NULL);
+        execv("./driver", argv.data());
+        perror("driver exec failed");
+        _exit(1);
+    }
+
+    close(in_pipe[0]);
+    close(out_pipe[1]);
+    to_driver = in_pipe[1];
+    from_driver = out_pipe[0];
+
+    string prompt;
+    return batch || wait_prompt(prompt);
+}
+
+bool DriverSession::send(const string& line) {
+    string data = line + "\n";
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(to_driver, data.data() + written, data.size() - written);
+        if (n <= 0) {
+            perror("write to driver failed");
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+bool DriverSession::wait_prompt(string& prompt) {
+    static const char* prompts[] = {
+        "Enter command: ", "Use history? (y/n): ", "Enter selection: ",
+        "Enter password (letters only): ", "Enter string (letters only): ", "Enter string (hex): ",
+        "Enter cipher (vigenere/chacha20): ", "-- More (Enter to continue, q to stop): "
+    };
+
+    char buffer[65536];
+    while (true) {
+        size_t line_start = output.rfind('\n');
+        string last = output.substr(line_start == string::npos ? 0 : line_start + 1);
+        for (const char* known : prompts) {
+            if (last == known) {
+                prompt = last;
+                return true;
+            }
+        }
+
+        struct pollfd readable = {from_driver, POLLIN, 0};
+        int ready = poll(&readable, 1, REPLY_TIMEOUT_MS);
+        if (ready == 0) {
+            cerr << "Error: No prompt from the driver after " << REPLY_TIMEOUT_MS << " ms\n";
+            return false;
+        }
+        ssize_t n = read(from_driver, buffer, sizeof(buffer));
+        if (n <= 0) {
+            cerr << "Error: Driver closed its output\n";
+            return false;
+        }
+        output.append(buffer, n);
+    }
+}
+
+bool DriverSession::run(const Command& command, bool& failed) {
+    output.clear();
+    if (!send(command.name)) {
+        return false;
+    }
+
+    string prompt;
+    while (wait_prompt(prompt)) {
+        if (prompt == "Enter command: ") {
+            failed = output.find("Error") != string::npos || output.find("ERROR") != string::npos ||
+                     output.find("Unknown command") != string::npos;
+            return true;
+        }
+
+        // Answer each follow-up prompt the command raises
+        string answer;
+        if (prompt == "Use history? (y/n): " || prompt == "Enter selection: ") {
+            answer = prompt[0] == 'U' ? "n" : "0";
+        } else if (prompt[0] == '-') {
+            answer = "q";
+        } else {
+            answer = command.argument;
+        }
+        output.clear();
+        if (!send(answer)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+uint64_t now_ns() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool DriverSession::run_batch(const vector<Command>& commands, size_t window,
+                              vector<uint64_t>& latencies, vector<bool>& failed) {
+    // A command's latency runs from the write that carries it to its result
+    // record. Without a limit the writer would push the whole stream at
+    // once and latency would be mostly time queued behind earlier commands;
+    // with at most `window` in flight that queueing is bounded by the window.
+    vector<atomic<uint64_t>> sent(commands.size());
+    mutex lock;
+    condition_variable progress;
+    size_t completed = 0;
+    bool stopped = false;  // The reader gave up
+    thread writer([&]() {
+        const size_t CHUNK = min<size_t>(64, window);
+        for (size_t first = 0; first < commands.size(); first += CHUNK) {
+            size_t last = min(first + CHUNK, commands.size());
+            {
+                unique_lock<mutex> guard(lock);
+                progress.wait(guard, [&]() { return stopped || last - completed <= window; });
+                if (stopped) {
+                    return;
+                }
+            }
+            string data;
+            for (size_t i = first; i < last; i++) {
+                data += commands[i].name;
+                if (!commands[i].argument.empty()) {
+                    data += " " + commands[i].argument;
+                }
+                data += i + 1 < last ? "\n" : "";
+            }
+            uint64_t now = now_ns();
+            for (size_t i = first; i < last; i++) {
+                sent[i] = now;
+            }
+            if (!send(data)) {
+                return;
+            }
+        }
+    });
+
+    latencies.assign(commands.size(), 0);
+    failed.assign(commands.size(), false);
+    size_t next = 0;
+    char buffer[65536];
+    while (next < commands.size()) {
+        struct pollfd readable = {from_driver, POLLIN, 0};
+        ssize_t n = 0;
+        if (poll(&readable, 1, REPLY_TIMEOUT_MS) > 0) {
+            n = read(from_driver, buffer, sizeof(buffer));
+        }
+        if (n <= 0) {
+            cerr << "Error: Driver stopped answering after " << next << " commands\n";
+            break;
+        }
+        uint64_t now = now_ns();
+        output.append(buffer, n);
+
+        // HISTORY lines belong to the result record that follows them
+        size_t start = 0, newline;
+        while ((newline = output.find('\n', start)) != string::npos && next < commands.size()) {
+            bool ok = output.compare(start, 3, "OK ") == 0;
+            if (ok || output.compare(start, 6, "ERROR ") == 0) {
+                latencies[next] = now - sent[next];
+                failed[next] = !ok;
+                next++;
+            }
+            start = newline + 1;
+        }
+        output.erase(0, start);
+        {
+            lock_guard<mutex> guard(lock);
+            completed = next;
+        }
+        progress.notify_one();
+    }
+    {
+        lock_guard<mutex> guard(lock);
+        stopped = true;
+    }
+    progress.notify_one();
+    writer.join();
+    return next == commands.size();
+}
+
+int DriverSession::finish() {
+    send("quit");
+    close(to_driver);
+
+    // Drain the output so the driver never blocks writing its goodbye
+    char buffer[4096];
+    while (read(from_driver, buffer, sizeof(buffer)) > 0) {
+    }
+    close(from_driver);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return status;
+}
+
+uint64_t percentile(const vector<uint64_t>& sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+// One latency object: count, summary statistics and the log2 histogram
+string latency_json(Samples samples) {
+    vector<uint64_t>& sorted = samples.latencies;
+    sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for (uint64_t ns : sorted) {
+        total += ns;
+    }
+
+    vector<size_t> buckets(HISTOGRAM_BUCKETS, 0);
+    for (uint64_t ns : sorted) {
+        uint64_t us = ns / 1000;
+        int bucket = 0;
+        while (bucket < HISTOGRAM_BUCKETS - 1 && (1ull << bucket) <= us) {
+            bucket++;
+        }
+        buckets[bucket]++;
+    }
+    int last = HISTOGRAM_BUCKETS - 1;
+    while (last > 0 && buckets[last] == 0) {
+        last--;
+    }
+
+    ostringstream json;
+    json << "{\"count\": " << sorted.size() << ", \"errors\": " << samples.errors;
+    json << ", \"mean_us\": " << (sorted.empty() ? 0 : total / sorted.size() / 1000);
+    json << ", \"p50_us\": " << percentile(sorted, 0.50) / 1000.0;
+    json << ", \"p90_us\": " << percentile(sorted, 0.90) / 1000.0;
+    json << ", \"p99_us\": " << percentile(sorted, 0.99) / 1000.0;
+    json << ", \"p999_us\": " << percentile(sorted, 0.999) / 1000.0;
+    json << ", \"max_us\": " << (sorted.empty() ? 0 : sorted.back() / 1000.0);
+    // Bucket i counts latencies below 2^i us (and at least 2^(i-1) us)
+    json << ", \"histogram\": [";
+    for (int i = 0; i <= last; i++) {
+        json << (i ? ", " : "") << "{\"lt_us\": " << (1ull << i) << ", \"count\": " << buckets[i] << "}";
+    }
+    json << "]}";
+    return json.str();
+}
+
+string json_string(const string& text) {
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+void usage(const char* program) {
+    cerr << "Usage: " << program << " [--script <file|-> | --generate <n>] [--seed <n>] [--json <file>]"
+         << " [--label <text>] [--dir <directory>] [--batch] [--window <n>] [-- <driver options>]\n";
+}
+
+int main(int argc, char* argv[]) {
+    string script;
+    size_t generate = 20000;
+    unsigned seed = 42;
+    string json_path = "driver_bench.json";
+    string label;
+    string directory = "/tmp";
+    bool batch = false;
+    size_t window = DEFAULT_WINDOW;
+    vector<string> driver_options;
+
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--script" && i + 1 < argc) {
+            script = argv[++i];
+        } else if (option == "--generate" && i + 1 < argc) {
+            generate = strtoul(argv[++i], NULL, 10);
+        } else if (option == "--seed" && i + 1 < argc) {
+            seed = strtoul(argv[++i], NULL, 10);
+        } else if (option == "--json" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (option == "--label" && i + 1 < argc) {
+            label = argv[++i];
+        } else if (option == "--dir" && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (option == "--batch") {
+            batch = true;
+        } else if (option == "--window" && i + 1 < argc) {
+            window = max<size_t>(strtoul(argv[++i], NULL, 10), 1);
+        } else if (option == "--") {
+            driver_options.assign(argv + i + 1, argv + argc);
+            break;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    vector<Command> commands;
+    if (!script.empty()) {
+        if (!read_script(script, commands)) {
+            return 1;
+        }
+    } else {
+        commands = generate_commands(generate, seed);
+    }
+    // quit is sent at the end; a script's own quit would end the session early
+    commands.erase(remove_if(commands.begin(), commands.end(),
+                             [](const Command& c) { return c.name == "quit"; }), commands.end());
+
+    // A fresh log and history each run, so runs are comparable
+    string log_path = directory + "/driver_bench.log";
+    string history_path = directory + "/driver_bench.history";
+    remove(log_path.c_str());
+    remove(history_path.c_str());
+    remove((history_path + ".idx").c_str());
+
+    vector<string> args = {"driver", log_path, "--history-file", history_path};
+    if (batch) {
+        args.push_back("--batch");
+        args.push_back("-");
+    }
+    args.insert(args.end(), driver_options.begin(), driver_options.end());
+
+    signal(SIGPIPE, SIG_IGN);
+    DriverSession session;
+    if (!session.start(args, batch)) {
+        return 1;
+    }
+
+    map<string, Samples> by_command;
+    Samples all;
+    auto record = [&](const Command& command, uint64_t ns, bool failed) {
+        Samples& samples = by_command[command.name];
+        samples.latencies.push_back(ns);
+        all.latencies.push_back(ns);
+        if (failed) {
+            samples.errors++;
+            all.errors++;
+        }
+    };
+
+    auto start = chrono::steady_clock::now();
+    if (batch) {
+        vector<uint64_t> latencies;
+        vector<bool> failed;
+        if (!session.run_batch(commands, window, latencies, failed)) {
+            session.finish();
+            return 1;
+        }
+        for (size_t i = 0; i < commands.size(); i++) {
+            record(commands[i], latencies[i], failed[i]);
+        }
+    } else {
+        for (const Command& command : commands) {
+            bool failed = false;
+            auto sent = chrono::steady_clock::now();
+            if (!session.run(command, failed)) {
+                session.finish();
+                return 1;
+            }
+            record(command, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - sent).count(),
+                   failed);
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    session.finish();
+
+    double rate = commands.size() / seconds;
+    printf("%-10s %8s %7s %10s %10s %10s %10s\n", "command", "count", "errors", "p50 us", "p99 us", "max us", "mean us");
+    auto print_row = [](const string& name, Samples samples) {
+        sort(samples.latencies.begin(), samples.latencies.end());
+        double total = 0;
+        for (uint64_t ns : samples.latencies) {
+            total += ns;
+        }
+        size_t count = samples.latencies.size();
+        printf("%-10s %8zu %7zu %10.1f %10.1f %10.1f %10.1f\n", name.c_str(), count, samples.errors,
+               percentile(samples.latencies, 0.50) / 1000.0, percentile(samples.latencies, 0.99) / 1000.0,
+               count ? samples.latencies.back() / 1000.0 : 0.0, count ? total / count / 1000 : 0.0);
+    };
+    for (const auto& entry : by_command) {
+        print_row(entry.first, entry.second);
+    }
+    print_row("all", all);
+    printf("%zu commands in %.3f s: %.0f commands/sec\n", commands.size(), seconds, rate);
+
+    // Machine-readable results for comparing runs
+    ofstream json(json_path);
+    if (!json.is_open()) {
+        cerr << "Error: Unable to write " << json_path << "\n";
+        return 1;
+    }
+    json << "{\n";
+    json << "  \"label\": " << json_string(label) << ",\n";
+    json << "  \"timestamp\": " << time(NULL) << ",\n";
+    json << "  \"source\": " << json_string(script.empty() ? "generate " + to_string(generate) + " seed " + to_string(seed)
+                                                        : "script " + script) << ",\n";
+    json << "  \"mode\": \"" << (batch ? "batch" : "interactive") << "\",\n";
+    if (batch) {
+        json << "  \"window\": " << window << ",\n";
+    }
+    json << "  \"commands\": " << commands.size() << ",\n";
+    json << "  \"errors\": " << all.errors << ",\n";
+    json << "  \"seconds\": " << seconds << ",\n";
+    json << "  \"commands_per_sec\": " << rate << ",\n";
+    json << "  \"latency\": {\n";
+    json << "    \"all\": " << latency_json(all);
+    for (const auto& entry : by_command) {
+        json << ",\n    " << json_string(entry.first) << ": " << latency_json(entry.second);
+    }
+    json << "\n  }\n}\n";
+    cout << "Results written to " << json_path << "\n";
+    return 0;
+}
@@ -1,115 +1,396 @@
-#include <iostream>
 #include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <thread>
 #include <algorithm>
 #include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <sys/random.h>
+#include <unistd.h>
+#include "cipher_engine.h"
+#include "trace.h"
 
 using namespace std;
 
-string vingener_encrypt(const string& text, const string& key) {
-    string result = "";
-    size_t keyIndex = 0;
+// The request path works on views into one reused input buffer and builds
+// replies in one reused output arena, so once both have grown to fit the
+// largest request seen, serving a request allocates nothing.
+//
+// Replies are not flushed one by one. They collect in the arena and go out
+// in one write when the reader has run out of input and would block, or
+// when the arena passes REPLY_FLUSH_BYTES. A lone interactive request is
+// therefore answered as soon as it is processed, while a pipelined batch of
+// N requests costs a few reads and writes instead of N of each.
 
-    for (char c : text) {
-        if (isalpha(c)) {
-            // Convert to uppercase for uniformity 
-            char base = 'A';
-            char upperC = toupper(c);
+#ifdef ALLOC_COUNT_HOOK
+// Test hook: count every heap allocation so the steady-state claim above can
+// be checked (make alloc-check). Reported on stderr at exit.
+#include <atomic>
+#include <new>
 
-            // Apply Vingenere encryption (text_char + key_char) mod 26
-            char encryptedChar = ((upperC - base) + (toupper(key[keyIndex]) - base)) % 26 + base;
+static atomic<size_t> allocation_count(0);
 
-            result += encryptedChar;
-            keyIndex = (keyIndex + 1) % key.length();
-        } else {
-            // Non alphabetic characters remain unchanged
-            result += c;
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (p == NULL) throw bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// Requests before this many are warm-up: buffers may still be growing
+static const size_t ALLOC_WARMUP_REQUESTS = 100;
+#endif
+
+bool is_alpha_only(string_view str) {
+    return all_of(str.begin(), str.end(), [](unsigned char c) {
+        return isalpha(c) || isspace(c);
+    });
+}
+
+bool equals_ignore_case(string_view a, string_view b) {
+    return a.size() == b.size() && equal(a.begin(), a.end(), b.begin(), [](unsigned char x, unsigned char y) {
+        return toupper(x) == toupper(y);
+    });
+}
+
+int hex_value(unsigned char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c = toupper(c);
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Binary ciphertext travels as uppercase hex on the line protocol
+void hex_encode(const char* bytes, size_t n, char* hex) {
+    static const char digits[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < n; i++) {
+        unsigned char b = bytes[i];
+        hex[2 * i] = digits[b >> 4];
+        hex[2 * i + 1] = digits[b & 0x0F];
+    }
+}
+
+bool hex_decode(string_view hex, vector<char>& bytes) {
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+    bytes.resize(hex.size() / 2);
+    for (size_t i = 0; i < bytes.size(); i++) {
+        int high = hex_value(hex[2 * i]);
+        int low = hex_value(hex[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
         }
+        bytes[i] = static_cast<char>(high << 4 | low);
     }
-    
-    return result;
+    return true;
 }
 
-string vigenere_decrypt(const string& text, const string& key) {
-    string result = "";
-    size_t keyIndex = 0;
+const size_t REPLY_FLUSH_BYTES = 64 * 1024;
 
-    for (char c : text) {
-        if (isalpha(c)) {
-            // Convert to uppercase for uniformity
-            char base = 'A';
-            char upperC = toupper(c);
+// Line reader over stdin that hands out views into its own buffer.
+// A view stays valid until the next call to next_line().
+class RequestReader {
+public:
+    RequestReader() : begin(0), end(0), at_eof(false) {
+        buffer.resize(64 * 1024);
+    }
 
-            // Apply Vingenere decryption (text_char - key_char + 26) mod 26
-            char decryptedChar = ((upperC - base) - (toupper(key[keyIndex]) - base) + 26) % 26 + base;
+    // True when the next next_line() would have to wait on the pipe
+    bool would_block() const {
+        if (at_eof || memchr(buffer.data() + begin, '\n', end - begin) != NULL) {
+            return false;
+        }
+        struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+        return poll(&input, 1, 0) == 0;
+    }
 
-            result += decryptedChar;
-            keyIndex = (keyIndex + 1) % key.length();
+    bool next_line(string_view& line) {
+        while (true) {
+            char* start = buffer.data() + begin;
+            char* newline = static_cast<char*>(memchr(start, '\n', end - begin));
+            if (newline != NULL) {
+                line = string_view(start, newline - start);
+                begin += line.size() + 1;
+                return true;
+            }
+            if (at_eof) {
+                // Last line without a trailing newline
+                if (begin == end) return false;
+                line = string_view(start, end - begin);
+                begin = end;
+                return true;
+            }
+            fill();
+        }
+    }
+
+private:
+    void fill() {
+        // Slide the partial line to the front, growing only for longer lines
+        if (begin > 0) {
+            memmove(buffer.data(), buffer.data() + begin, end - begin);
+            end -= begin;
+            begin = 0;
+        }
+        if (end == buffer.size()) {
+            buffer.resize(buffer.size() * 2);
+        }
+
+        TRACE_SPAN("pipe read", "pipe");
+        ssize_t bytes_read;
+        do {
+            bytes_read = read(STDIN_FILENO, buffer.data() + end, buffer.size() - end);
+        } while (bytes_read < 0 && errno == EINTR);
+
+        if (bytes_read <= 0) {
+            at_eof = true;
         } else {
-            // Non alphabetic characters remain unchanged
-            result += c;
+            end += bytes_read;
         }
     }
 
-    return result;
-}
+    vector<char> buffer;
+    size_t begin;
+    size_t end;
+    bool at_eof;
+};
 
-bool is_alpha_only(const string& str) {
-    return all_of(str.begin(), str.end(), [](char c) {
-        return isalpha(c) || isspace(c);
-    });
-}
+// Replies waiting to be written, plus the one under construction
+class ReplyArena {
+public:
+    ReplyArena() : used(0), reply_start(0), flush_each(false) {
+        buffer.resize(64 * 1024);
+    }
+
+    void append(string_view text) {
+        memcpy(reserve(text.size()), text.data(), text.size());
+    }
+
+    // Returns room for n bytes at the end of the reply. Earlier pointers
+    // into the arena are invalidated.
+    char* reserve(size_t n) {
+        if (used + n > buffer.size() && reply_start > 0) {
+            // Make room by writing out the finished replies before growing
+            write_all(buffer.data(), reply_start);
+            memmove(buffer.data(), buffer.data() + reply_start, used - reply_start);
+            used -= reply_start;
+            reply_start = 0;
+        }
+        if (used + n > buffer.size()) {
+            buffer.resize(max(buffer.size() * 2, used + n));
+        }
+        char* p = buffer.data() + used;
+        used += n;
+        return p;
+    }
+
+    // Drops whatever has been built for the current reply
+    void reset() { used = reply_start; }
+
+    // Completes the current reply; it is written out by the next flush
+    void reply(string_view text) {
+        append(text);
+        append("\n");
+        reply_start = used;
+        if (flush_each || used >= REPLY_FLUSH_BYTES) {
+            flush();
+        }
+    }
+
+    // Restores the old one-write-per-reply behaviour
+    void set_flush_each(bool enabled) { flush_each = enabled; }
+
+    void flush() {
+        write_all(buffer.data(), used);
+        used = 0;
+        reply_start = 0;
+    }
+
+private:
+    static void write_all(const char* data, size_t length) {
+        TRACE_SPAN("pipe write", "pipe");
+        size_t written = 0;
+        while (written < length) {
+            ssize_t n = write(STDOUT_FILENO, data + written, length - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                perror("Write reply failed");
+                exit(1);
+            }
+            written += n;
+        }
+    }
+
+    vector<char> buffer;
+    size_t used;
+    size_t reply_start;
+    bool flush_each;
+};
+
+int main(int argc, char* argv[]) {
+    TRACE_INIT("encryption");
+
+    // Every engine is built up front so MODE is only a pointer switch
+    unique_ptr<CipherEngine> engines[] = {make_cipher_engine("VIGENERE"), make_cipher_engine("CHACHA20")};
+    CipherEngine* engine = engines[0].get();
 
-int main() {
     string passkey = "";
-    string command, argument;
+    vector<char> decoded;
+    decoded.reserve(64 * 1024);
+    unsigned threads = max(1u, thread::hardware_concurrency());
+
+    RequestReader reader;
+    ReplyArena out;
+    string_view line;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--flush-each") == 0) {
+            out.set_flush_each(true);
+        }
+    }
+#ifdef ALLOC_COUNT_HOOK
+    size_t requests = 0;
+    size_t warm_allocations = 0;
+#endif
 
     while (true) {
-        string line;
-        if (!getline(cin, line)) {
+        // Flush point: nothing more to serve without waiting on the driver
+        if (reader.would_block()) {
+            out.flush();
+        }
+        if (!reader.next_line(line)) {
             break;
         }
 
+#ifdef ALLOC_COUNT_HOOK
+        if (++requests == ALLOC_WARMUP_REQUESTS) {
+            warm_allocations = allocation_count.load();
+        }
+#endif
         size_t spacePos = line.find_first_of(" \t");
-        command = line.substr(0, spacePos);
-        argument = "";
+        string_view command = line.substr(0, spacePos);
+        string_view argument = "";
 
-        if (spacePos != string::npos) {
+        if (spacePos != string_view::npos) {
             argument = line.substr(spacePos + 1);
         }
 
-        transform(command.begin(), command.end(), command.begin(), ::toupper);
+        if (equals_ignore_case(command, "PASS") || equals_ignore_case(command, "PASSKEY")) {
+            // Key material is derived once here, not per request
+            passkey.assign(argument.data(), argument.size());
+            engine->init(passkey);
+            out.reply("RESULT");
+        }
+        else if (equals_ignore_case(command, "MODE")) {
+            CipherEngine* selected = NULL;
+            for (unique_ptr<CipherEngine>& candidate : engines) {
+                if (equals_ignore_case(argument, candidate->name())) {
+                    selected = candidate.get();
+                }
+            }
 
-        if (command == "PASS" || command == "PASSKEY") {
-            passkey = argument;
-            cout << "RESULT" << endl;
+            if (argument.empty()) {
+                out.append("RESULT ");
+                out.reply(engine->name());
+            } else if (selected == NULL) {
+                out.reply("ERROR Unknown cipher mode");
+            } else {
+                // Carry the current password over to the new engine
+                engine = selected;
+                engine->init(passkey);
+                out.append("RESULT ");
+                out.reply(engine->name());
+            }
         }
-        else if (command == "ENCRYPT") {
-            if (passkey.empty()) {
-                cout << "ERROR: Password not set" << endl;
+        else if (equals_ignore_case(command, "ENCRYPT")) {
+            if (!engine->ready()) {
+                out.reply("ERROR: Password not set");
             } else if (!is_alpha_only(argument)) {
-                cout << "ERROR Input must contain only letters" << endl;
+                out.reply("ERROR Input must contain only letters");
+            } else if (engine->binary_output()) {
+                // A fresh nonce per message, sent ahead of the ciphertext
+                uint8_t nonce[CipherEngine::MAX_NONCE_SIZE];
+                size_t nonce_size = engine->nonce_size();
+                if (getrandom(nonce, nonce_size, 0) != static_cast<ssize_t>(nonce_size)) {
+                    out.reply("ERROR Unable to generate a nonce");
+                } else {
+                    engine->set_nonce(nonce);
+
+                    // Encrypt in place in the input buffer, then hex-encode into the reply
+                    char* text = const_cast<char*>(argument.data());
+                    cipher_process_parallel(*engine, false, text, text, argument.size(), threads);
+                    out.append("RESULT: ");
+                    char* hex = out.reserve((nonce_size + argument.size()) * 2);
+                    hex_encode(reinterpret_cast<const char*>(nonce), nonce_size, hex);
+                    hex_encode(text, argument.size(), hex + nonce_size * 2);
+                    out.reply("");
+                }
             } else {
-                string encrypted = vingener_encrypt(argument, passkey);
-                cout << "RESULT: " << encrypted << endl;
+                out.append("RESULT: ");
+                char* result = out.reserve(argument.size());
+                cipher_process_parallel(*engine, false, argument.data(), result, argument.size(), threads);
+                out.reply("");
             }
         }
-        else if (command == "DECRYPT") {
-            if (passkey.empty()) {
-                cout << "ERROR: Password not set" << endl;
-            } else if (!is_alpha_only(argument)) {
-                cout << "ERROR Input must contain only letters" << endl;
+        else if (equals_ignore_case(command, "DECRYPT")) {
+            string_view input = argument;
+            if (!engine->ready()) {
+                out.reply("ERROR: Password not set");
+            } else if (engine->binary_output() && !hex_decode(argument, decoded)) {
+                out.reply("ERROR Input must be hexadecimal");
+            } else if (engine->binary_output() && decoded.size() < engine->nonce_size()) {
+                out.reply("ERROR Input is missing its nonce");
+            } else if (!engine->binary_output() && !is_alpha_only(argument)) {
+                out.reply("ERROR Input must contain only letters");
             } else {
-                string decrypted = vigenere_decrypt(argument, passkey);
-                cout << "RESULT " << decrypted << endl;
+                if (engine->binary_output()) {
+                    // The ciphertext follows the nonce it was encrypted under
+                    size_t nonce_size = engine->nonce_size();
+                    engine->set_nonce(reinterpret_cast<const uint8_t*>(decoded.data()));
+                    input = string_view(decoded.data() + nonce_size, decoded.size() - nonce_size);
+                }
+                out.append("RESULT ");
+                char* result = out.reserve(input.size());
+                cipher_process_parallel(*engine, true, input.data(), result, input.size(), threads);
+                if (!is_alpha_only(string_view(result, input.size()))) {
+                    // Wrong key or corrupted ciphertext; don't put raw bytes on the pipe
+                    out.reset();
+                    out.reply("ERROR Decryption did not produce text");
+                } else {
+                    out.reply("");
+                }
             }
         }
-        else if (command == "QUIT") {
+        else if (equals_ignore_case(command, "PING")) {
+            // Liveness probe; the driver times its first reply
+            out.reply("PONG");
+        }
+        else if (equals_ignore_case(command, "QUIT")) {
             break;
         }
         else {
-            cout << "ERROR: Invalid command" << endl;
+            out.reply("ERROR: Invalid command");
         }
     }
 
+    out.flush();
+
+#ifdef ALLOC_COUNT_HOOK
+    if (requests >= ALLOC_WARMUP_REQUESTS) {
+        fprintf(stderr, "alloc-hook: %zu allocations in %zu steady-state requests\n",
+                allocation_count.load() - warm_allocations, requests - ALLOC_WARMUP_REQUESTS);
+    }
+#endif
     return 0;
-}
\ No newline at end of file
+}
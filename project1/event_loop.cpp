@@ -0,0 +1,194 @@
+#include "event_loop.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include "trace.h"
+
+using namespace std;
+
+void set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags != -1) {
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+}
+
+EventLoop::EventLoop() {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        perror("epoll_create1 failed");
+    }
+}
+
+EventLoop::~EventLoop() {
+    if (epoll_fd != -1) {
+        close(epoll_fd);
+    }
+}
+
+bool EventLoop::add(int fd, uint32_t events, Handler handler) {
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        return false;
+    }
+    handlers[fd] = handler;
+    return true;
+}
+
+void EventLoop::modify(int fd, uint32_t events) {
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+}
+
+void EventLoop::remove(int fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    handlers.erase(fd);
+}
+
+void EventLoop::run_once(int timeout_ms) {
+    const int MAX_EVENTS = 16;
+    struct epoll_event events[MAX_EVENTS];
+
+    int ready = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout_ms);
+    if (ready < 0) {
+        if (errno != EINTR) {
+            perror("epoll_wait failed");
+        }
+        return;
+    }
+
+    for (int i = 0; i < ready; i++) {
+        // A handler may remove other fds, so look each one up again
+        auto found = handlers.find(events[i].data.fd);
+        if (found != handlers.end()) {
+            Handler handler = found->second;
+            handler(events[i].events);
+        }
+    }
+}
+
+OutputQueue::OutputQueue(EventLoop& loop, const char* name, size_t max_bytes)
+    : loop(loop), name(name), max_bytes(max_bytes), out_fd(-1), offset(0),
+      watching(false), is_broken(false), dropped_count(0) {}
+
+void OutputQueue::attach(int fd) {
+    out_fd = fd;
+    is_broken = false;
+    set_nonblocking(fd);
+    drain();
+}
+
+int OutputQueue::detach() {
+    watch_writable(false);
+    int fd = out_fd;
+    out_fd = -1;
+    return fd;
+}
+
+bool OutputQueue::write(const string& data) {
+    if (queued() + data.size() > max_bytes) {
+        dropped_count++;
+        return false;
+    }
+
+    // Compact once everything before offset has been written
+    if (offset > 0 && offset == pending.size()) {
+        pending.clear();
+        offset = 0;
+    }
+    pending += data;
+    drain();
+    return !is_broken;
+}
+
+void OutputQueue::drain() {
+    TRACE_SPAN("pipe write", "pipe", name);
+    while (out_fd != -1 && offset < pending.size()) {
+        ssize_t written = ::write(out_fd, pending.data() + offset, pending.size() - offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                // Reader is gone (EPIPE); keep the data for whoever replaces it
+                if (!is_broken) {
+                    fprintf(stderr, "Write to %s failed: %s\n", name, strerror(errno));
+                }
+                is_broken = true;
+                watch_writable(false);
+                return;
+            }
+            break;
+        }
+        offset += written;
+    }
+
+    if (offset == pending.size()) {
+        pending.clear();
+        offset = 0;
+    } else if (offset > 64 * 1024) {
+        pending.erase(0, offset);
+        offset = 0;
+    }
+    watch_writable(out_fd != -1 && !empty());
+}
+
+void OutputQueue::watch_writable(bool enabled) {
+    if (enabled == watching) {
+        return;
+    }
+    if (enabled) {
+        watching = loop.add(out_fd, EPOLLOUT, [this](uint32_t) { drain(); });
+    } else {
+        if (out_fd != -1) {
+            loop.remove(out_fd);
+        }
+        watching = false;
+    }
+}
+
+bool LineReader::read_from(int fd) {
+    TRACE_SPAN("pipe read", "pipe");
+    // One read per call: the loop is level-triggered, so anything left is
+    // reported again, and a blocking stdin is never read past what's there
+    char chunk[4096];
+    ssize_t bytes_read;
+    do {
+        bytes_read = read(fd, chunk, sizeof(chunk));
+    } while (bytes_read < 0 && errno == EINTR);
+
+    if (bytes_read > 0) {
+        buffer.append(chunk, bytes_read);
+        return true;
+    }
+    if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return true;
+    }
+    at_eof = true;
+    return false;
+}
+
+bool LineReader::next_line(string& line) {
+    size_t newline = buffer.find(delimiter, start);
+    if (newline == string::npos) {
+        // Drop consumed lines so the buffer only holds the partial one
+        buffer.erase(0, start);
+        start = 0;
+        // Hand out a final unterminated line once input has ended
+        if (at_eof && !buffer.empty()) {
+            line.swap(buffer);
+            buffer.clear();
+            return true;
+        }
+        return false;
+    }
+    line.assign(buffer, start, newline - start);
+    start = newline + 1;
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+// Thin wrapper around epoll: each watched fd has one handler that is
+// called with the ready events.
+class EventLoop {
+public:
+    typedef std::function<void(uint32_t events)> Handler;
+
+    EventLoop();
+    ~EventLoop();
+
+    // Returns false (errno set) if the fd can't be watched, e.g. a regular file
+    bool add(int fd, uint32_t events, Handler handler);
+    void modify(int fd, uint32_t events);
+    void remove(int fd);
+
+    // Waits up to timeout_ms (-1 = forever) and dispatches ready fds
+    void run_once(int timeout_ms);
+
+private:
+    int epoll_fd;
+    std::unordered_map<int, Handler> handlers;
+};
+
+// Non-blocking writer for one pipe. Data that doesn't fit in the pipe is
+// queued and written as the fd becomes writable, so a slow reader never
+// blocks the loop. Past max_bytes queued, new messages are dropped and
+// counted instead of growing without bound.
+class OutputQueue {
+public:
+    OutputQueue(EventLoop& loop, const char* name, size_t max_bytes);
+
+    void attach(int fd);
+    int detach();  // Stops watching and returns the fd; queued data is kept
+    int fd() const { return out_fd; }
+
+    // False if the message was dropped or the reader has gone away
+    bool write(const std::string& data);
+    void clear() { pending.clear(); offset = 0; }  // Discards anything not yet written
+    bool empty() const { return offset == pending.size(); }
+    size_t queued() const { return pending.size() - offset; }
+    size_t dropped() const { return dropped_count; }
+    bool broken() const { return is_broken; }
+
+private:
+    void drain();
+    void watch_writable(bool enabled);
+
+    EventLoop& loop;
+    const char* name;
+    size_t max_bytes;
+    int out_fd;
+    std::string pending;
+    size_t offset;
+    bool watching;
+    bool is_broken;
+    size_t dropped_count;
+};
+
+// Accumulates bytes from a non-blocking fd and splits them into lines
+// ending in delimiter ('\n', or '\0' for NUL-separated records)
+class LineReader {
+public:
+    explicit LineReader(char delimiter = '\n') : delimiter(delimiter), start(0), at_eof(false) {}
+
+    // Does one read; false once the fd reports EOF or an error
+    bool read_from(int fd);
+    bool next_line(std::string& line);
+    bool has_line() const { return buffer.find(delimiter, start) != std::string::npos; }
+    bool eof() const { return at_eof; }
+    void clear() { buffer.clear(); start = 0; at_eof = false; }
+
+private:
+    char delimiter;
+    std::string buffer;
+    size_t start;  // Lines before this have already been handed out
+    bool at_eof;
+};
+
+void set_nonblocking(int fd);
+
+#endif
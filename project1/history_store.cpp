@@ -0,0 +1,236 @@
+#include "history_store.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const char HISTORY_MAGIC[8] = {'D', 'R', 'V', 'H', 'I', 'S', 'T', '1'};
+static const size_t MIN_DATA_LENGTH = 64 * 1024;
+static const size_t MIN_INDEX_ENTRIES = 1024;
+
+HistoryStore::HistoryStore()
+    : capacity(0), data_fd(-1), index_fd(-1), data_map(NULL), index_map(NULL),
+      data_length(0), index_length(0) {}
+
+HistoryStore::~HistoryStore() {
+    close();
+}
+
+bool HistoryStore::map_file(int fd, size_t length, char** mapping) {
+    // Map the new length before dropping the old mapping, so a failure
+    // (say, ENOSPC) leaves the store readable as it was
+    if (ftruncate(fd, length) == -1) {
+        perror("History resize failed");
+        return false;
+    }
+    void* addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        perror("History mmap failed");
+        return false;
+    }
+    if (*mapping != NULL) {
+        munmap(*mapping, fd == data_fd ? data_length : index_length);
+    }
+    *mapping = static_cast<char*>(addr);
+    return true;
+}
+
+bool HistoryStore::open(const string& path, size_t cap) {
+    close();
+    capacity = cap;
+
+    data_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    index_fd = ::open((path + ".idx").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (data_fd == -1 || index_fd == -1) {
+        perror("History open failed");
+        close();
+        return false;
+    }
+
+    struct stat data_stat, index_stat;
+    fstat(data_fd, &data_stat);
+    fstat(index_fd, &index_stat);
+
+    bool fresh = static_cast<size_t>(index_stat.st_size) < sizeof(Header);
+    size_t min_index = sizeof(Header) + MIN_INDEX_ENTRIES * sizeof(uint64_t);
+    data_length = max(static_cast<size_t>(data_stat.st_size), MIN_DATA_LENGTH);
+    index_length = max(static_cast<size_t>(index_stat.st_size), min_index);
+
+    if (!map_file(data_fd, data_length, &data_map) || !map_file(index_fd, index_length, &index_map)) {
+        close();
+        return false;
+    }
+
+    if (fresh || memcmp(header()->magic, HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) != 0 ||
+        !header_valid(index_stat.st_size, data_stat.st_size)) {
+        // New, unrecognised or damaged store (say, an index whose data file
+        // was deleted): start empty
+        memcpy(header()->magic, HISTORY_MAGIC, sizeof(HISTORY_MAGIC));
+        header()->count = 0;
+        header()->first = 0;
+        header()->data_end = 0;
+        header()->dead_bytes = 0;
+    }
+
+    // A smaller cap than last run simply retires the oldest entries
+    while (capacity > 0 && size() > capacity) {
+        header()->dead_bytes += record_bytes(offsets()[header()->first]);
+        header()->first++;
+    }
+    if (header()->first > 0) {
+        compact();
+    }
+    return true;
+}
+
+// The header must fit the files as they are on disk, and the newest record
+// must end inside the data (a data file truncated or replaced under its
+// index fails here). Other records are checked as they are read.
+bool HistoryStore::header_valid(size_t index_size, size_t data_size) const {
+    const Header* h = header();
+    if (h->first > h->count || h->count > (index_size - sizeof(Header)) / sizeof(uint64_t) ||
+        h->data_end > data_size || h->dead_bytes > h->data_end) {
+        return false;
+    }
+    return h->first == h->count || record_valid(offsets()[h->count - 1]);
+}
+
+// A record's length prefix and text lie within the used part of the data file
+bool HistoryStore::record_valid(uint64_t offset) const {
+    uint64_t end = header()->data_end;
+    if (offset > end || end - offset < sizeof(uint32_t)) {
+        return false;
+    }
+    uint32_t length;
+    memcpy(&length, data_map + offset, sizeof(length));
+    return end - offset - sizeof(length) >= length;
+}
+
+void HistoryStore::close() {
+    if (index_map != NULL) {
+        size_t used_index = sizeof(Header) + header()->count * sizeof(uint64_t);
+        size_t used_data = header()->data_end;
+        munmap(index_map, index_length);
+        index_map = NULL;
+        // Drop the growth slack so the files on disk hold only real records
+        if (ftruncate(index_fd, used_index) == -1) perror("History truncate failed");
+        if (data_fd != -1 && ftruncate(data_fd, used_data) == -1) perror("History truncate failed");
+    }
+    if (data_map != NULL) {
+        munmap(data_map, data_length);
+        data_map = NULL;
+    }
+    if (data_fd != -1) ::close(data_fd);
+    if (index_fd != -1) ::close(index_fd);
+    data_fd = index_fd = -1;
+}
+
+bool HistoryStore::grow_data(size_t needed) {
+    if (needed <= data_length) return true;
+    size_t length = data_length;
+    while (length < needed) length *= 2;
+    if (!map_file(data_fd, length, &data_map)) return false;
+    data_length = length;
+    return true;
+}
+
+bool HistoryStore::grow_index(size_t needed) {
+    if (needed <= index_length) return true;
+    size_t length = index_length;
+    while (length < needed) length *= 2;
+    if (!map_file(index_fd, length, &index_map)) return false;
+    index_length = length;
+    return true;
+}
+
+void HistoryStore::append(const string& entry) {
+    if (index_map == NULL) return;
+
+    uint32_t length = entry.length();
+    uint64_t offset = header()->data_end;
+    if (!grow_data(offset + sizeof(length) + length) ||
+        !grow_index(sizeof(Header) + (header()->count + 1) * sizeof(uint64_t))) {
+        return;
+    }
+
+    memcpy(data_map + offset, &length, sizeof(length));
+    memcpy(data_map + offset + sizeof(length), entry.data(), length);
+    offsets()[header()->count] = offset;
+
+    // Publish the record only after its bytes are in place
+    header()->data_end = offset + sizeof(length) + length;
+    header()->count++;
+
+    if (capacity > 0 && size() > capacity) {
+        header()->dead_bytes += record_bytes(offsets()[header()->first]);
+        header()->first++;
+    }
+    if ((header()->first > 0 && header()->first >= size()) ||
+        (header()->dead_bytes > MIN_DATA_LENGTH && header()->dead_bytes * 2 > header()->data_end)) {
+        compact();
+    }
+}
+
+void HistoryStore::touch(size_t index) {
+    if (capacity == 0 || index >= size()) return;
+
+    string entry = at(index);
+    uint64_t* live = offsets() + header()->first;
+    header()->dead_bytes += record_bytes(live[index]);
+    memmove(live + index, live + index + 1, (size() - index - 1) * sizeof(uint64_t));
+    header()->count--;
+    append(entry);
+}
+
+string HistoryStore::at(size_t index) const {
+    if (index >= size()) return "";
+    uint64_t offset = offsets()[header()->first + index];
+    if (!record_valid(offset)) return "";
+    uint32_t length;
+    memcpy(&length, data_map + offset, sizeof(length));
+    return string(data_map + offset + sizeof(length), length);
+}
+
+size_t HistoryStore::size() const {
+    if (index_map == NULL) return 0;
+    return header()->count - header()->first;
+}
+
+uint32_t HistoryStore::record_bytes(uint64_t offset) const {
+    if (!record_valid(offset)) return 0;
+    uint32_t length;
+    memcpy(&length, data_map + offset, sizeof(length));
+    return sizeof(length) + length;
+}
+
+void HistoryStore::compact() {
+    // Live records are stored in offset order, so sliding each one down
+    // toward the start of the file never overwrites a record not yet moved.
+    // A damaged entry (out of bounds, or overlapping the record before it)
+    // would break that, so it is dropped instead.
+    uint64_t write_pos = 0;
+    uint64_t read_end = 0;
+    size_t live = size();
+    size_t kept = 0;
+    uint64_t* index = offsets();
+    for (size_t i = 0; i < live; i++) {
+        uint64_t offset = index[header()->first + i];
+        if (offset < read_end || !record_valid(offset)) {
+            continue;
+        }
+        uint32_t bytes = record_bytes(offset);
+        memmove(data_map + write_pos, data_map + offset, bytes);
+        index[kept++] = write_pos;
+        write_pos += bytes;
+        read_end = offset + bytes;
+    }
+    header()->data_end = write_pos;
+    header()->dead_bytes = 0;
+    header()->first = 0;
+    header()->count = kept;
+}
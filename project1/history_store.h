@@ -0,0 +1,65 @@
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Persistent history kept in two memory-mapped files:
+//   <path>      append-only records, each a 4-byte length followed by the text
+//   <path>.idx  a small header followed by one 8-byte data offset per record
+// Reopening loads instantly: the files are mapped, not parsed, and only the
+// header and the newest record are checked against them. at(i) is a single
+// index lookup that checks the record's offset and length as it reads it.
+//
+// With a capacity set the store behaves as an LRU-bounded ring: only the
+// most recent `capacity` entries are live, touch() moves an entry to the
+// most recent slot, and dead records are compacted away once they make up
+// half of the index or of the data file.
+class HistoryStore {
+public:
+    HistoryStore();
+    ~HistoryStore();
+
+    // Opens (or creates) the store. capacity == 0 means unbounded.
+    bool open(const std::string& path, size_t capacity);
+    void close();
+
+    void append(const std::string& entry);
+    void touch(size_t index);
+
+    // Index 0 is the oldest live entry
+    std::string at(size_t index) const;
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+
+private:
+    struct Header {
+        char magic[8];
+        uint64_t count;      // records ever appended (since last compaction)
+        uint64_t first;      // first live record
+        uint64_t data_end;   // bytes used in the data file
+        uint64_t dead_bytes; // data bytes no longer referenced by a live record
+    };
+
+    bool map_file(int fd, size_t length, char** mapping);
+    bool header_valid(size_t index_size, size_t data_size) const;
+    bool record_valid(uint64_t offset) const;
+    bool grow_data(size_t needed);
+    bool grow_index(size_t needed);
+    uint32_t record_bytes(uint64_t offset) const;
+    void compact();
+
+    Header* header() const { return reinterpret_cast<Header*>(index_map); }
+    uint64_t* offsets() const { return reinterpret_cast<uint64_t*>(index_map + sizeof(Header)); }
+
+    size_t capacity;
+    int data_fd;
+    int index_fd;
+    char* data_map;
+    char* index_map;
+    size_t data_length;
+    size_t index_length;
+};
+
+#endif
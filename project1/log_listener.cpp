@@ -0,0 +1,215 @@
+#include "log_listener.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "trace.h"
+
+using namespace std;
+
+// Largest packet a producer may send
+const size_t MAX_PACKET_BYTES = 64 * 1024;
+
+static uint64_t realtime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void LogSink::write(uint64_t timestamp_ns, string_view action, string_view message) {
+    TRACE_SPAN("log write", "logger");
+    if (binary != NULL) {
+        binary->write(timestamp_ns, action, message);
+        return;
+    }
+    string record = binary_record_text(timestamp_ns, action, message);
+    log.rotate_if_due(record.size());
+    log.append(record);
+}
+
+LogListener::LogListener(LogSink& sink)
+    : sink(sink), listen_fd(-1), signal_fd(-1), timer_fd(-1), stopping(false),
+      next_sequence(0), record_count(0), packet(MAX_PACKET_BYTES) {}
+
+LogListener::~LogListener() {
+    for (int fd : producers) {
+        close(fd);
+    }
+    if (listen_fd != -1) {
+        close(listen_fd);
+        unlink(socket_path.c_str());
+    }
+    if (signal_fd != -1) close(signal_fd);
+    if (timer_fd != -1) close(timer_fd);
+}
+
+bool LogListener::listen(const string& path) {
+    socket_path = path;
+
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path.c_str());
+        return false;
+    }
+    strcpy(address.sun_path, path.c_str());
+
+    listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        perror("socket failed");
+        return false;
+    }
+    // A socket file left by an earlier run would make bind fail
+    unlink(path.c_str());
+    if (bind(listen_fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == -1 ||
+        ::listen(listen_fd, SOMAXCONN) == -1) {
+        perror("bind/listen failed");
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    loop.add(listen_fd, EPOLLIN, [this](uint32_t) { accept_producers(); });
+
+    // Stop cleanly on SIGINT/SIGTERM so held records are written
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    loop.add(signal_fd, EPOLLIN, [this](uint32_t) { stopping = true; });
+
+    // Held records are released as their window passes, even when idle
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    struct itimerspec timer = {};
+    timer.it_interval.tv_nsec = REORDER_WINDOW_MS * 1000000 / 2;
+    timer.it_value = timer.it_interval;
+    timerfd_settime(timer_fd, 0, &timer, NULL);
+    loop.add(timer_fd, EPOLLIN, [this](uint32_t) {
+        uint64_t expirations;
+        if (read(timer_fd, &expirations, sizeof(expirations)) > 0) {
+            release(false);
+        }
+    });
+    return true;
+}
+
+void LogListener::run() {
+    while (!stopping) {
+        loop.run_once(-1);
+    }
+
+    // Take in whatever producers had already sent before stopping
+    accept_producers();
+    vector<int> remaining = producers;
+    for (int fd : remaining) {
+        read_producer(fd, EPOLLIN);
+    }
+    release(true);
+}
+
+void LogListener::accept_producers() {
+    int fd;
+    while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+        producers.push_back(fd);
+        loop.add(fd, EPOLLIN, [this, fd](uint32_t events) { read_producer(fd, events); });
+    }
+}
+
+void LogListener::read_producer(int fd, uint32_t events) {
+    // Drain what is queued, then release once for the whole batch
+    while (true) {
+        ssize_t received = recv(fd, packet.data(), packet.size(), 0);
+        if (received > 0) {
+            uint64_t now = realtime_ns();
+            string_view data(packet.data(), received);
+            size_t start = 0;
+            while (start < data.size()) {
+                size_t newline = data.find('\n', start);
+                size_t end = newline == string_view::npos ? data.size() : newline;
+                if (end > start) {
+                    add_record(data.substr(start, end - start), now);
+                }
+                start = end + 1;
+            }
+            continue;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            close_producer(fd);
+        }
+        break;
+    }
+    if (events & (EPOLLHUP | EPOLLERR) && !(events & EPOLLIN)) {
+        close_producer(fd);
+    }
+    release(false);
+}
+
+void LogListener::close_producer(int fd) {
+    auto found = find(producers.begin(), producers.end(), fd);
+    if (found == producers.end()) {
+        return;
+    }
+    producers.erase(found);
+    loop.remove(fd);
+    close(fd);
+}
+
+void LogListener::add_record(string_view line, uint64_t received) {
+    if (line == "QUIT") {
+        return;  // One producer leaving doesn't stop the others
+    }
+
+    uint64_t timestamp = received;
+    if (line[0] == '@') {
+        // A stamp that isn't all digits keeps the receive time, like an
+        // unstamped record, rather than sorting to the epoch
+        size_t space = line.find(' ');
+        string stamp(line.substr(1, space == string_view::npos ? string_view::npos : space - 1));
+        char* end = NULL;
+        errno = 0;
+        unsigned long long value = strtoull(stamp.c_str(), &end, 10);
+        if (!stamp.empty() && isdigit(static_cast<unsigned char>(stamp[0])) && *end == '\0' && errno == 0) {
+            timestamp = value;
+        }
+        line = space == string_view::npos ? string_view() : line.substr(space + 1);
+    }
+
+    size_t space = line.find_first_of(" \t");
+    Pending record;
+    record.timestamp = timestamp;
+    record.sequence = next_sequence++;
+    record.action = string(line.substr(0, space));
+    record.message = space == string_view::npos ? string() : string(line.substr(space + 1));
+    pending.push(move(record));
+}
+
+void LogListener::release(bool all) {
+    uint64_t horizon = realtime_ns() - REORDER_WINDOW_MS * 1000000;
+    size_t written = 0;
+    while (!pending.empty() &&
+           (all || pending.top().timestamp <= horizon || pending.size() > REORDER_MAX_RECORDS)) {
+        const Pending& record = pending.top();
+        sink.write(record.timestamp, record.action, record.message);
+        pending.pop();
+        written++;
+    }
+    if (written > 0) {
+        sink.flush();
+        record_count += written;
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef LOG_LISTENER_H
+#define LOG_LISTENER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "binary_log.h"
+#include "event_loop.h"
+#include "log_rotator.h"
+
+// Writes records in the format the logger was started with
+class LogSink {
+public:
+    LogSink(RotatingLog& log, BinaryLogWriter* binary) : log(log), binary(binary) {}
+
+    void write(uint64_t timestamp_ns, std::string_view action, std::string_view message);
+    void flush() { log.flush(); }
+
+private:
+    RotatingLog& log;
+    BinaryLogWriter* binary;  // NULL for the text format
+};
+
+// Records are held this long so late arrivals from other producers can
+// still be written in timestamp order
+const uint64_t REORDER_WINDOW_MS = 20;
+
+// Past this many held records the oldest are written regardless
+const size_t REORDER_MAX_RECORDS = 8192;
+
+// Multi-producer mode: accepts any number of producers on a Unix
+// SOCK_SEQPACKET socket. Each packet holds one or more newline-separated
+// records in the pipe protocol ("ACTION message"), optionally prefixed by
+// "@<timestamp ns> " when the producer wants its own send time recorded.
+// Records pass through a small reorder buffer and are written in batches.
+class LogListener {
+public:
+    explicit LogListener(LogSink& sink);
+    ~LogListener();
+
+    bool listen(const std::string& socket_path);
+
+    // Serves producers until SIGINT or SIGTERM, then writes what is held
+    void run();
+    size_t records() const { return record_count; }
+
+private:
+    struct Pending {
+        uint64_t timestamp;
+        uint64_t sequence;   // Arrival order breaks timestamp ties
+        std::string action;
+        std::string message;
+    };
+
+    struct Later {
+        bool operator()(const Pending& a, const Pending& b) const {
+            return a.timestamp != b.timestamp ? a.timestamp > b.timestamp : a.sequence > b.sequence;
+        }
+    };
+
+    void accept_producers();
+    void read_producer(int fd, uint32_t events);
+    void close_producer(int fd);
+    void add_record(std::string_view line, uint64_t received);
+    void release(bool all);
+
+    LogSink& sink;
+    EventLoop loop;
+    std::string socket_path;
+    int listen_fd;
+    int signal_fd;
+    int timer_fd;
+    bool stopping;
+
+    std::priority_queue<Pending, std::vector<Pending>, Later> pending;
+    uint64_t next_sequence;
+    size_t record_count;
+    std::vector<int> producers;
+    std::vector<char> packet;
+};
+
+#endif
@@ -0,0 +1,247 @@
+#include "log_rotator.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "lz_codec.h"
+#include "trace.h"
+
+using namespace std;
+
+const char COMPRESSED_SUFFIX[] = ".lz";
+
+// Parses "<base>.<n>" or "<base>.<n>.lz"; false for any other name
+static bool parse_segment_name(const string& name, const string& base, unsigned long& number, bool& compressed) {
+    if (name.size() <= base.size() + 1 || name.compare(0, base.size(), base) != 0 || name[base.size()] != '.') {
+        return false;
+    }
+    string rest = name.substr(base.size() + 1);
+    compressed = rest.size() > 3 && rest.compare(rest.size() - 3, 3, COMPRESSED_SUFFIX) == 0;
+    if (compressed) {
+        rest.resize(rest.size() - 3);
+    }
+    if (rest.empty() || rest.find_first_not_of("0123456789") != string::npos) {
+        return false;
+    }
+    number = strtoul(rest.c_str(), NULL, 10);
+    return true;
+}
+
+static vector<LogSegment> list_segments(const string& directory, const string& base) {
+    vector<LogSegment> segments;
+    DIR* dir = opendir(directory.c_str());
+    if (dir == NULL) {
+        return segments;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        LogSegment segment;
+        if (!parse_segment_name(entry->d_name, base, segment.number, segment.compressed)) {
+            continue;
+        }
+        segment.file = directory + "/" + entry->d_name;
+        struct stat info;
+        segment.bytes = stat(segment.file.c_str(), &info) == 0 ? info.st_size : 0;
+        segments.push_back(segment);
+    }
+    closedir(dir);
+
+    sort(segments.begin(), segments.end(), [](const LogSegment& a, const LogSegment& b) {
+        return a.number < b.number;
+    });
+    return segments;
+}
+
+vector<LogSegment> list_log_segments(const string& path) {
+    size_t slash = path.rfind('/');
+    return list_segments(slash == string::npos ? "." : path.substr(0, slash),
+                         slash == string::npos ? path : path.substr(slash + 1));
+}
+
+RotatingLog::RotatingLog() : file_bytes(0), opened_at(0), next_segment(1), stopping(false) {
+    policy = {0, 0, 0, 0, true};
+}
+
+RotatingLog::~RotatingLog() {
+    close();
+}
+
+bool RotatingLog::open(const string& log_path, const RotationPolicy& rotation,
+                       const string& suffix) {
+    path = log_path;
+    policy = rotation;
+    sidecar_suffix = suffix;
+    sidecar = suffix.empty() ? "" : path + suffix;
+    size_t slash = path.rfind('/');
+    directory = slash == string::npos ? "." : path.substr(0, slash);
+    base_name = slash == string::npos ? path : path.substr(slash + 1);
+
+    file.open(path, ios::app | ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    if (!sidecar.empty()) {
+        sidecar_file.open(sidecar, ios::app | ios::binary);
+        if (!sidecar_file.is_open()) {
+            return false;
+        }
+    }
+    struct stat info;
+    file_bytes = stat(path.c_str(), &info) == 0 ? info.st_size : 0;
+    opened_at = time(0);
+
+    // Continue numbering after existing segments, and finish compressing
+    // any that an earlier run rotated but didn't get to
+    for (const LogSegment& segment : list_segments(directory, base_name)) {
+        next_segment = max(next_segment, segment.number + 1);
+        if (!segment.compressed) {
+            rotated.push_back(segment.file);
+        }
+    }
+
+    stopping = false;
+    worker = thread(&RotatingLog::worker_main, this);
+    return true;
+}
+
+void RotatingLog::close() {
+    if (!worker.joinable()) {
+        return;
+    }
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+    file.close();
+    sidecar_file.close();
+}
+
+void RotatingLog::write(const string& record) {
+    TRACE_SPAN("log write", "logger");
+    rotate_if_due(record.size());
+    append(record);
+    flush();
+}
+
+bool RotatingLog::rotate_if_due(size_t record_bytes) {
+    bool too_big = policy.max_bytes && file_bytes + record_bytes > policy.max_bytes && file_bytes > 0;
+    bool too_old = policy.max_seconds && time(0) - opened_at >= policy.max_seconds;
+    if (too_big || too_old) {
+        rotate();
+        return true;
+    }
+    return false;
+}
+
+void RotatingLog::append(const string& data) {
+    file << data;
+    file_bytes += data.size();
+}
+
+void RotatingLog::append_sidecar(const string& data) {
+    sidecar_file << data;
+}
+
+void RotatingLog::flush() {
+    TRACE_SPAN("log flush", "logger");
+    file.flush();
+    if (sidecar_file.is_open()) {
+        sidecar_file.flush();
+    }
+}
+
+void RotatingLog::rotate() {
+    // Rename and reopen: cheap enough to do inline, everything slow is queued
+    file.close();
+    string segment = path + "." + to_string(next_segment++);
+    if (rename(path.c_str(), segment.c_str()) != 0) {
+        cerr << "Warning: Unable to rotate " << path << ": " << strerror(errno) << endl;
+    } else {
+        if (!sidecar.empty()) {
+            sidecar_file.close();
+            rename(sidecar.c_str(), (segment + sidecar_suffix).c_str());
+            sidecar_file.open(sidecar, ios::app | ios::binary);
+        }
+        {
+            lock_guard<mutex> guard(lock);
+            rotated.push_back(segment);
+        }
+        wake.notify_one();
+    }
+
+    file.open(path, ios::app | ios::binary);
+    file_bytes = 0;
+    opened_at = time(0);
+}
+
+void RotatingLog::worker_main() {
+    // Signals belong to the writer's thread (which may wait on them via signalfd)
+    sigset_t signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        wake.wait(guard, [this]() { return stopping || !rotated.empty(); });
+        if (rotated.empty()) {
+            break;  // Stopping, with nothing left to compress
+        }
+        string segment = rotated.front();
+        rotated.pop_front();
+        guard.unlock();
+
+        if (policy.compress && access(segment.c_str(), F_OK) == 0) {
+            // Retention may already have removed it
+            TRACE_SPAN("compress segment", "logger");
+            if (lz_compress_file(segment, segment + COMPRESSED_SUFFIX)) {
+                remove(segment.c_str());
+            } else {
+                cerr << "Warning: Unable to compress " << segment << endl;
+            }
+        }
+        apply_retention();
+
+        guard.lock();
+    }
+}
+
+void RotatingLog::apply_retention() {
+    if (!policy.keep_segments && !policy.keep_bytes) {
+        return;
+    }
+
+    vector<LogSegment> segments = list_segments(directory, base_name);
+    size_t total = 0;
+    for (const LogSegment& segment : segments) {
+        total += segment.bytes;
+    }
+
+    // Drop the oldest segments until both limits hold
+    size_t count = segments.size();
+    for (const LogSegment& segment : segments) {
+        bool too_many = policy.keep_segments && count > policy.keep_segments;
+        bool too_large = policy.keep_bytes && total > policy.keep_bytes;
+        if (!too_many && !too_large) {
+            break;
+        }
+        remove(segment.file.c_str());
+        if (!sidecar_suffix.empty()) {
+            string data = segment.compressed ? segment.file.substr(0, segment.file.size() - 3) : segment.file;
+            remove((data + sidecar_suffix).c_str());
+        }
+        count--;
+        total -= segment.bytes;
+    }
+}
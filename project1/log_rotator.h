@@ -0,0 +1,89 @@
+#ifndef LOG_ROTATOR_H
+#define LOG_ROTATOR_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// When the live log is rotated and how many old segments are kept.
+// A limit of 0 means "no limit".
+struct RotationPolicy {
+    size_t max_bytes;       // Rotate once the live file reaches this size
+    long max_seconds;       // Rotate once the live file is this old
+    size_t keep_segments;   // Rotated segments kept, newest first
+    size_t keep_bytes;      // Total size of rotated segments kept
+    bool compress;          // Compress rotated segments to <segment>.lz
+};
+
+// A rotated segment found on disk
+struct LogSegment {
+    unsigned long number;
+    std::string file;      // Full path, including any .lz suffix
+    bool compressed;
+    size_t bytes;
+};
+
+// Rotated segments of the log at path, oldest first
+std::vector<LogSegment> list_log_segments(const std::string& path);
+
+// Append-only log file that rotates itself. Rotation is a rename and a
+// reopen on the writer's thread; compression and retention run on a
+// background thread so writers never wait for them. Rotated segments are
+// named <path>.<n> (or <path>.<n>.lz once compressed), with n increasing.
+// An optional sidecar file (<path><suffix>) is rotated along with the log
+// to <path>.<n><suffix>; it is never compressed.
+class RotatingLog {
+public:
+    RotatingLog();
+    ~RotatingLog();
+
+    bool open(const std::string& path, const RotationPolicy& policy,
+              const std::string& sidecar_suffix = "");
+    void close();
+
+    // Writes one complete record (including its newline) and flushes it
+    void write(const std::string& record);
+
+    // For formats that need to know about file boundaries: rotate_if_due()
+    // rotates if a record of this size should start a new file and returns
+    // true if it did; append() then writes without checking again. Appended
+    // data is buffered until flush(), so a batch costs one write.
+    bool rotate_if_due(size_t record_bytes);
+    void append(const std::string& data);
+    void append_sidecar(const std::string& data);
+    void flush();
+    size_t size() const { return file_bytes; }  // Bytes in the live file
+    const std::string& sidecar_path() const { return sidecar; }
+
+private:
+    void rotate();
+    void worker_main();
+    void apply_retention();
+
+    std::string path;
+    std::string directory;
+    std::string base_name;   // File name of path, the prefix of every segment
+    std::string sidecar_suffix;
+    std::string sidecar;
+    RotationPolicy policy;
+
+    std::ofstream file;
+    std::ofstream sidecar_file;
+    size_t file_bytes;
+    time_t opened_at;
+    unsigned long next_segment;
+
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<std::string> rotated;  // Segments waiting for compression
+    bool stopping;
+};
+
+#endif
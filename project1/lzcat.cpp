@@ -0,0 +1,21 @@
+#include <iostream>
+#include "lz_codec.h"
+
+using namespace std;
+
+// Prints compressed log segments (<log>.<n>.lz) as plain text
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <segment.lz>..." << endl;
+        return 1;
+    }
+
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!lz_decompress_file(argv[i], cout)) {
+            cerr << "Error: Unable to decompress " << argv[i] << endl;
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,94 @@
+#include "result_cache.h"
+
+using namespace std;
+
+// 64-bit FNV-1a, seeded so the same bytes hash differently per field
+static uint64_t fnv1a(const string& data, uint64_t hash = 14695981039346656037ULL) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+ResultCache::ResultCache(size_t byte_budget)
+    : budget(byte_budget), used_bytes(0), hit_count(0), miss_count(0), key_fingerprint(0) {}
+
+void ResultCache::set_key(const string& key) {
+    clear();
+    key_fingerprint = fnv1a(key);
+}
+
+void ResultCache::clear() {
+    lru.clear();
+    index.clear();
+    used_bytes = 0;
+}
+
+uint64_t ResultCache::make_key(const string& operation, const string& input) const {
+    uint64_t hash = fnv1a(operation, key_fingerprint);
+    hash ^= fnv1a(input) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+size_t ResultCache::entry_bytes(const Entry& entry) const {
+    // Strings plus a rough allowance for the list node and hash bucket
+    return entry.operation.size() + entry.input.size() + entry.response.size() + sizeof(Entry) + 64;
+}
+
+bool ResultCache::lookup(const string& operation, const string& input, string& response) {
+    if (budget == 0) {
+        return false;
+    }
+
+    auto found = index.find(make_key(operation, input));
+    // Compare the stored request too, so a hash collision is only a miss
+    if (found == index.end() || found->second->operation != operation || found->second->input != input) {
+        miss_count++;
+        return false;
+    }
+
+    lru.splice(lru.begin(), lru, found->second);
+    response = found->second->response;
+    hit_count++;
+    return true;
+}
+
+void ResultCache::store(const string& operation, const string& input, const string& response) {
+    if (budget == 0) {
+        return;
+    }
+
+    uint64_t key = make_key(operation, input);
+    auto found = index.find(key);
+    if (found != index.end()) {
+        used_bytes -= entry_bytes(*found->second);
+        lru.erase(found->second);
+        index.erase(found);
+    }
+
+    Entry entry = {key, operation, input, response};
+    size_t size = entry_bytes(entry);
+    if (size > budget) {
+        return;  // Would never fit; don't flush the cache for it
+    }
+
+    evict_to(budget - size);
+    lru.push_front(entry);
+    index[key] = lru.begin();
+    used_bytes += size;
+}
+
+void ResultCache::evict_to(size_t limit) {
+    while (used_bytes > limit && !lru.empty()) {
+        used_bytes -= entry_bytes(lru.back());
+        index.erase(lru.back().key);
+        lru.pop_back();
+    }
+}
+
+string ResultCache::stats() const {
+    return "hits=" + to_string(hit_count) + " misses=" + to_string(miss_count) +
+           " entries=" + to_string(lru.size()) + " bytes=" + to_string(used_bytes) +
+           "/" + to_string(budget);
+}
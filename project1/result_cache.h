@@ -0,0 +1,51 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+// Bounded LRU cache of encryption replies, keyed by (operation, key
+// fingerprint, input hash). Lets the driver answer repeated requests
+// without a round trip to the encryption process. Memory is bounded by a
+// byte budget counting stored strings plus per-entry overhead.
+class ResultCache {
+public:
+    explicit ResultCache(size_t byte_budget);
+
+    // Forgets every entry and starts fingerprinting with the new key
+    void set_key(const std::string& key);
+    void clear();
+
+    bool lookup(const std::string& operation, const std::string& input, std::string& response);
+    void store(const std::string& operation, const std::string& input, const std::string& response);
+
+    size_t hits() const { return hit_count; }
+    size_t misses() const { return miss_count; }
+    size_t bytes() const { return used_bytes; }
+    std::string stats() const;
+
+private:
+    struct Entry {
+        uint64_t key;
+        std::string operation;
+        std::string input;
+        std::string response;
+    };
+
+    uint64_t make_key(const std::string& operation, const std::string& input) const;
+    size_t entry_bytes(const Entry& entry) const;
+    void evict_to(size_t budget);
+
+    size_t budget;
+    size_t used_bytes;
+    size_t hit_count;
+    size_t miss_count;
+    uint64_t key_fingerprint;
+    std::list<Entry> lru;  // Most recently used at the front
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+};
+
+#endif
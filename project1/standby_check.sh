@@ -0,0 +1,76 @@
+#!/bin/sh
+# Logger failover with rotation: runs the driver with --standby and a
+# logger that rotates every few records, kills the active logger halfway
+# through, and checks that every record made it into the log or one of
+# its segments. Records are delivered at least once: one the dead logger
+# wrote but had not acknowledged is written again, so the encrypt count
+# may come out above 100 but never below. Usage: standby_check.sh [directory holding driver, logger
+# and encryption]
+
+bin=$(cd "${1:-.}" && pwd) || exit 1
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+mkfifo "$work/in"
+
+# Records across the live log and its segments matching a pattern
+count() {
+    cat "$work"/log.txt* 2>/dev/null | grep -cF "$1"
+}
+
+# Waits up to 20 s (sanitizer builds are slow) for count "$1" to reach $2
+wait_for() {
+    tries=0
+    while [ "$(count "$1")" -lt "$2" ]; do
+        tries=$((tries + 1))
+        if [ $tries -gt 400 ]; then
+            echo "standby-check: timed out waiting for $2 '$1' records" >&2
+            return 1
+        fi
+        sleep 0.05
+    done
+}
+
+cd "$bin" || exit 1
+./driver "$work/log.txt" --batch "$work/in" --standby -- --rotate-bytes 400 --no-compress > "$work/out" 2> "$work/err" &
+driver=$!
+exec 3> "$work/in"
+
+echo "password secretkey" >&3
+i=0
+while [ $i -lt 80 ]; do
+    echo "encrypt hello" >&3
+    i=$((i + 1))
+done
+wait_for "User entered: encrypt" 80 || { kill $driver; exit 1; }
+
+# The oldest logger is the active one; the standby was started after it
+kill "$(pgrep -o -P $driver -x logger)"
+i=0
+while [ $i -lt 20 ]; do
+    echo "encrypt world" >&3
+    i=$((i + 1))
+done
+echo "quit" >&3
+exec 3>&-
+wait $driver
+
+status=0
+for expected in "[START] 1" "[RESTART] 1" "User entered: password 1" "User entered: encrypt 100+"; do
+    pattern=${expected% *}
+    want=${expected##* }
+    got=$(count "$pattern")
+    case $want in
+        *+) ok=$([ "$got" -ge "${want%+}" ] && echo yes) ;;
+        *) ok=$([ "$got" -eq "$want" ] && echo yes) ;;
+    esac
+    if [ -z "$ok" ]; then
+        echo "standby-check: expected $want '$pattern' records, found $got" >&2
+        status=1
+    fi
+done
+if [ $status -eq 0 ]; then
+    echo "standby-check: passed"
+else
+    cat "$work/err" >&2
+fi
+exit $status
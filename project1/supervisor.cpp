@@ -0,0 +1,330 @@
+#include "supervisor.h"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <ctime>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+// First restart delay, doubled after each quick failure
+const uint64_t INITIAL_BACKOFF_MS = 10;
+const uint64_t MAX_BACKOFF_MS = 2000;
+
+// A child that ran this long counts as healthy and resets the backoff
+const uint64_t STABLE_RUN_US = 1000 * 1000;
+
+// Quick failures in a row before the supervisor stops trying
+const int MAX_FAILURES = 8;
+
+uint64_t now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Closes whichever ends of a pipe are open
+static void close_pipe(int fds[2]) {
+    if (fds[0] != -1) close(fds[0]);
+    if (fds[1] != -1) close(fds[1]);
+}
+
+bool spawn_child(Child& child, const string& path, const vector<string>& args,
+                 bool capture_output, const string& ready_env) {
+    int in_pipe[2] = {-1, -1};
+    int out_pipe[2] = {-1, -1};
+    int ready_pipe[2] = {-1, -1};
+    if (pipe2(in_pipe, O_CLOEXEC) == -1 ||
+        (capture_output && pipe2(out_pipe, O_CLOEXEC) == -1) ||
+        (!ready_env.empty() && pipe2(ready_pipe, O_CLOEXEC) == -1)) {
+        perror("Pipe creation failed");
+        close_pipe(in_pipe);
+        close_pipe(out_pipe);
+        return false;
+    }
+
+    vector<char*> argv;
+    for (const string& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(NULL);
+
+    // The child inherits the environment, plus where to find its ready pipe
+    vector<char*> envp;
+    string ready_var = ready_env + "=" + to_string(CHILD_READY_FD);
+    for (char** var = environ; *var != NULL; var++) {
+        envp.push_back(*var);
+    }
+    if (!ready_env.empty()) {
+        envp.push_back(const_cast<char*>(ready_var.c_str()));
+    }
+    envp.push_back(NULL);
+
+    // Redirect stdin (and stdout) to the pipes; dup2 clears close-on-exec
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in_pipe[0], STDIN_FILENO);
+    if (capture_output) {
+        posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+    }
+    if (!ready_env.empty()) {
+        posix_spawn_file_actions_adddup2(&actions, ready_pipe[1], CHILD_READY_FD);
+    }
+
+    // Undo the driver's signal setup before running the child program
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigaddset(&signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    uint64_t started = now_us();
+    pid_t pid;
+    int error = posix_spawn(&pid, path.c_str(), &actions, &attr, argv.data(), envp.data());
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    // Close the child's pipe ends in the parent
+    close(in_pipe[0]);
+    if (capture_output) {
+        close(out_pipe[1]);
+    }
+    if (!ready_env.empty()) {
+        close(ready_pipe[1]);
+    }
+
+    if (error != 0) {
+        fprintf(stderr, "Child execution failed: %s: %s\n", path.c_str(), strerror(error));
+        close(in_pipe[1]);
+        if (capture_output) close(out_pipe[0]);
+        if (!ready_env.empty()) close(ready_pipe[0]);
+        return false;
+    }
+
+    child.pid = pid;
+    child.in_fd = in_pipe[1];
+    child.out_fd = out_pipe[0];
+    child.ready_fd = ready_pipe[0];
+    child.started_us = started;
+    return true;
+}
+
+string resolve_program(const string& path) {
+    char resolved[PATH_MAX];
+    if (realpath(path.c_str(), resolved) == NULL || access(resolved, X_OK) != 0) {
+        return "";
+    }
+    return resolved;
+}
+
+Supervisor::Supervisor(EventLoop& loop, const char* name, const string& path,
+                       const vector<string>& args, bool capture_output, bool standby,
+                       const string& ready_env, const vector<string>& standby_extra)
+    : loop(loop), child_name(name), path(path), args(args), standby_args(args), capture_output(capture_output),
+      use_standby(standby), ready_env(ready_env), ready_reported(false), timer_fd(-1),
+      backoff_ms(INITIAL_BACKOFF_MS), failures(0),
+      given_up(false), stopped(false), down_since(0), restart_count(0),
+      last_downtime(0), total_downtime(0), from_standby(false) {
+    current = {-1, -1, -1, -1, 0};
+    this->standby = {-1, -1, -1, -1, 0};
+    standby_args.insert(standby_args.end(), standby_extra.begin(), standby_extra.end());
+}
+
+Supervisor::~Supervisor() {
+    if (timer_fd != -1) {
+        loop.remove(timer_fd);
+        close(timer_fd);
+    }
+}
+
+bool Supervisor::start(StartHandler start_handler, ExitHandler exit_handler) {
+    on_start = start_handler;
+    on_exit = exit_handler;
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1) {
+        perror("timerfd_create failed");
+        return false;
+    }
+    loop.add(timer_fd, EPOLLIN, [this](uint32_t) {
+        uint64_t expirations;
+        if (read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+            launch();
+        }
+    });
+
+    if (!spawn(current, args)) {
+        return false;
+    }
+    if (use_standby) {
+        spawn(standby, standby_args);
+    }
+    on_start(current, false);
+    return true;
+}
+
+bool Supervisor::child_exited(pid_t pid) {
+    if (pid == standby.pid) {
+        note_exit(standby);
+        release(standby);
+        if (!stopped && !given_up) {
+            schedule(backoff_ms);
+        }
+        return true;
+    }
+    if (pid != current.pid) {
+        return false;
+    }
+
+    down_since = now_us();
+    note_exit(current);
+    on_exit(current);
+    release(current);
+    if (stopped || given_up) {
+        return true;
+    }
+
+    if (standby.pid != -1) {
+        // Failover: the standby has already paid for fork+exec
+        Child ready = standby;
+        standby = {-1, -1, -1, -1, 0};
+        from_standby = true;
+        ready_reported = true;  // Its startup happened long before
+        promote(ready);
+        if (!stopped) {
+            schedule(backoff_ms);  // Refill the standby slot
+        }
+    } else {
+        schedule(backoff_ms);
+    }
+    return true;
+}
+
+void Supervisor::stop() {
+    stopped = true;
+    if (standby.pid != -1) {
+        // EOF on stdin makes the standby exit; it is reaped like any child
+        close(standby.in_fd);
+        standby.in_fd = -1;
+    }
+}
+
+void Supervisor::shutdown() {
+    stop();
+    for (Child* child : {&current, &standby}) {
+        // EOF on stdin ends the child; its other pipes stay open until it
+        // has exited so a late write to them can't raise SIGPIPE
+        if (child->in_fd != -1) {
+            close(child->in_fd);
+            child->in_fd = -1;
+        }
+        if (child->pid != -1) {
+            waitpid(child->pid, NULL, 0);
+        }
+        release(*child);
+    }
+}
+
+void Supervisor::note_exit(const Child& child) {
+    if (now_us() - child.started_us >= STABLE_RUN_US) {
+        backoff_ms = INITIAL_BACKOFF_MS;
+        failures = 0;
+        return;
+    }
+    backoff_ms = min(backoff_ms * 2, MAX_BACKOFF_MS);
+    if (++failures >= MAX_FAILURES && !stopped) {
+        fprintf(stderr, "%s exited %d times in a row; not restarting it\n", child_name, failures);
+        given_up = true;
+    }
+}
+
+void Supervisor::schedule(uint64_t delay_ms) {
+    struct itimerspec timer = {};
+    timer.it_value.tv_sec = delay_ms / 1000;
+    timer.it_value.tv_nsec = (delay_ms % 1000) * 1000000;
+    timerfd_settime(timer_fd, 0, &timer, NULL);
+}
+
+void Supervisor::launch() {
+    if (stopped || given_up) {
+        return;
+    }
+
+    if (current.pid == -1) {
+        Child fresh;
+        if (!spawn(fresh, args)) {
+            backoff_ms = min(backoff_ms * 2, MAX_BACKOFF_MS);
+            schedule(backoff_ms);
+            return;
+        }
+        from_standby = false;
+        ready_reported = false;
+        promote(fresh);
+    }
+
+    if (use_standby && standby.pid == -1 && !stopped) {
+        spawn(standby, standby_args);
+    }
+}
+
+void Supervisor::promote(Child& child) {
+    current = child;
+    restart_count++;
+    last_downtime = now_us() - down_since;
+    total_downtime += last_downtime;
+    on_start(current, true);
+}
+
+bool Supervisor::spawn(Child& child, const vector<string>& child_args) {
+    if (!spawn_child(child, path, child_args, capture_output, ready_env)) {
+        return false;
+    }
+    if (child.ready_fd != -1) {
+        pid_t pid = child.pid;
+        loop.add(child.ready_fd, EPOLLIN, [this, pid](uint32_t) { ready_signalled(pid); });
+    }
+    return true;
+}
+
+void Supervisor::ready_signalled(pid_t pid) {
+    // A byte or EOF both end the wait; the pipe has done its job either way
+    Child& child = pid == current.pid ? current : standby;
+    loop.remove(child.ready_fd);
+    close(child.ready_fd);
+    child.ready_fd = -1;
+    if (&child == &current) {
+        mark_ready();
+    }
+}
+
+void Supervisor::mark_ready() {
+    if (ready_reported || current.pid == -1) {
+        return;
+    }
+    ready_reported = true;
+    if (ready_handler) {
+        ready_handler(current, now_us() - current.started_us);
+    }
+}
+
+void Supervisor::release(Child& child) {
+    if (child.in_fd != -1) close(child.in_fd);
+    if (child.out_fd != -1) close(child.out_fd);
+    if (child.ready_fd != -1) {
+        loop.remove(child.ready_fd);
+        close(child.ready_fd);
+    }
+    child = {-1, -1, -1, -1, 0};
+}
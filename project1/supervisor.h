@@ -0,0 +1,120 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "event_loop.h"
+
+// A child program and the driver's ends of its pipes (-1 when unused)
+struct Child {
+    pid_t pid;
+    int in_fd;    // Driver writes the child's stdin here
+    int out_fd;   // Driver reads the child's stdout here
+    int ready_fd; // Becomes readable once the child reports it is ready
+    uint64_t started_us;
+};
+
+// Fd number the child finds its ready pipe on; its name is passed in ready_env
+const int CHILD_READY_FD = 3;
+
+// Starts `path` with posix_spawn, with stdin (and optionally stdout) on new
+// pipes. If ready_env is non-empty the child also gets a ready pipe on
+// CHILD_READY_FD and that variable set to its number. The driver's pipe
+// ends are close-on-exec so later children don't inherit them.
+bool spawn_child(Child& child, const std::string& path, const std::vector<std::string>& args,
+                 bool capture_output, const std::string& ready_env);
+
+// Absolute path of a program next to the working directory, resolved once
+// so restarts don't depend on later cwd or PATH changes
+std::string resolve_program(const std::string& path);
+
+// Monotonic clock in microseconds
+uint64_t now_us();
+
+// Keeps one child program running. When it exits, a prewarmed standby
+// (if enabled) takes over at once; otherwise a new child is started after
+// an exponential backoff. The owner is told through callbacks so it can
+// reattach pipes and replay state into the replacement.
+class Supervisor {
+public:
+    typedef std::function<void(Child& child, bool restarted)> StartHandler;
+    typedef std::function<void(Child& child)> ExitHandler;
+    typedef std::function<void(Child& child, uint64_t startup_us)> ReadyHandler;
+
+    // standby_args are appended to args when starting the standby, for
+    // children that must hold off on shared state until they take over
+    Supervisor(EventLoop& loop, const char* name, const std::string& path,
+               const std::vector<std::string>& args, bool capture_output, bool standby,
+               const std::string& ready_env = "",
+               const std::vector<std::string>& standby_args = std::vector<std::string>());
+    ~Supervisor();
+
+    // on_exit runs before a dead child's pipes are closed
+    bool start(StartHandler on_start, ExitHandler on_exit);
+
+    // Returns true if pid was one of this supervisor's children
+    bool child_exited(pid_t pid);
+
+    // No more restarts; the standby is told to exit by closing its stdin
+    void stop();
+
+    // Closes the children's pipes and waits for them to exit
+    void shutdown();
+
+    // Called once per freshly spawned active child when it first responds,
+    // either through its ready pipe or when the owner calls mark_ready()
+    void on_ready(ReadyHandler handler) { ready_handler = handler; }
+    void mark_ready();
+
+    const char* name() const { return child_name; }
+    Child& active() { return current; }
+    bool running() const { return current.pid != -1; }
+    bool gave_up() const { return given_up; }
+    bool restarting() const { return !running() && !given_up && !stopped; }
+
+    size_t restarts() const { return restart_count; }
+    uint64_t last_downtime_us() const { return last_downtime; }
+    uint64_t total_downtime_us() const { return total_downtime; }
+    bool last_from_standby() const { return from_standby; }
+
+private:
+    void note_exit(const Child& child);
+    void schedule(uint64_t delay_ms);
+    void launch();
+    void promote(Child& child);
+    void release(Child& child);
+    bool spawn(Child& child, const std::vector<std::string>& child_args);
+    void ready_signalled(pid_t pid);
+
+    EventLoop& loop;
+    const char* child_name;
+    std::string path;
+    std::vector<std::string> args;
+    std::vector<std::string> standby_args;  // args plus the standby's extras
+    bool capture_output;
+    bool use_standby;
+    std::string ready_env;
+
+    Child current;
+    Child standby;
+    StartHandler on_start;
+    ExitHandler on_exit;
+    ReadyHandler ready_handler;
+    bool ready_reported;  // The active child's startup time has been reported
+    int timer_fd;
+
+    uint64_t backoff_ms;
+    int failures;         // Consecutive exits shortly after starting
+    bool given_up;
+    bool stopped;
+    uint64_t down_since;  // When the active child was found dead
+    size_t restart_count;
+    uint64_t last_downtime;
+    uint64_t total_downtime;
+    bool from_standby;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include "vigenere.h"
+
+#include <cctype>
+
+using namespace std;
+
+namespace {
+
+// shift_table[s][c] is c shifted by s if c is a letter, else c itself.
+// is_letter[c] is 1 for letters so the key position advances without a branch.
+struct CipherTables {
+    unsigned char shift_table[26][256];
+    unsigned char is_letter[256];
+
+    CipherTables() {
+        for (int c = 0; c < 256; c++) {
+            is_letter[c] = isalpha(c) ? 1 : 0;
+            for (int s = 0; s < 26; s++) {
+                shift_table[s][c] = is_letter[c] ? 'A' + (toupper(c) - 'A' + s) % 26 : c;
+            }
+        }
+    }
+};
+
+const CipherTables& tables() {
+    static const CipherTables instance;
+    return instance;
+}
+
+void transform_into(const char* text, char* out, size_t n, const vector<uint8_t>& shifts, size_t& key_index) {
+    const CipherTables& t = tables();
+    const uint8_t* shift = shifts.data();
+    size_t key_length = shifts.size();
+
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = text[i];
+        out[i] = t.shift_table[shift[key_index]][c];
+        key_index += t.is_letter[c];
+        key_index = (key_index == key_length) ? 0 : key_index;
+    }
+}
+
+}
+
+KeySchedule build_key_schedule(string_view key) {
+    KeySchedule schedule;
+    build_key_schedule(key, schedule);
+    return schedule;
+}
+
+void build_key_schedule(string_view key, KeySchedule& schedule) {
+    schedule.encrypt_shifts.clear();
+    schedule.decrypt_shifts.clear();
+    for (char k : key) {
+        if (isalpha(static_cast<unsigned char>(k))) {
+            uint8_t shift = toupper(static_cast<unsigned char>(k)) - 'A';
+            schedule.encrypt_shifts.push_back(shift);
+            schedule.decrypt_shifts.push_back((26 - shift) % 26);
+        }
+    }
+}
+
+void vigenere_encrypt_into(const char* text, char* out, size_t n, const KeySchedule& schedule) {
+    size_t key_index = 0;
+    transform_into(text, out, n, schedule.encrypt_shifts, key_index);
+}
+
+void vigenere_decrypt_into(const char* text, char* out, size_t n, const KeySchedule& schedule) {
+    size_t key_index = 0;
+    transform_into(text, out, n, schedule.decrypt_shifts, key_index);
+}
+
+void vigenere_encrypt_into(const char* text, char* out, size_t n, const KeySchedule& schedule, size_t& key_index) {
+    transform_into(text, out, n, schedule.encrypt_shifts, key_index);
+}
+
+void vigenere_decrypt_into(const char* text, char* out, size_t n, const KeySchedule& schedule, size_t& key_index) {
+    transform_into(text, out, n, schedule.decrypt_shifts, key_index);
+}
+
+size_t vigenere_key_advance(const char* text, size_t n) {
+    const CipherTables& t = tables();
+    size_t letters = 0;
+    for (size_t i = 0; i < n; i++) {
+        letters += t.is_letter[static_cast<unsigned char>(text[i])];
+    }
+    return letters;
+}
+
+string vingener_encrypt(const string& text, const string& key) {
+    string result = "";
+    size_t keyIndex = 0;
+
+    for (char c : text) {
+        if (isalpha(c)) {
+            // Convert to uppercase for uniformity 
+            char base = 'A';
+            char upperC = toupper(c);
+
+            // Apply Vingenere encryption (text_char + key_char) mod 26
+            char encryptedChar = ((upperC - base) + (toupper(key[keyIndex]) - base)) % 26 + base;
+
+            result += encryptedChar;
+            keyIndex = (keyIndex + 1) % key.length();
+        } else {
+            // Non alphabetic characters remain unchanged
+            result += c;
+        }
+    }
+    
+    return result;
+}
+
+string vigenere_decrypt(const string& text, const string& key) {
+    string result = "";
+    size_t keyIndex = 0;
+
+    for (char c : text) {
+        if (isalpha(c)) {
+            // Convert to uppercase for uniformity
+            char base = 'A';
+            char upperC = toupper(c);
+
+            // Apply Vingenere decryption (text_char - key_char + 26) mod 26
+            char decryptedChar = ((upperC - base) - (toupper(key[keyIndex]) - base) + 26) % 26 + base;
+
+            result += decryptedChar;
+            keyIndex = (keyIndex + 1) % key.length();
+        } else {
+            // Non alphabetic characters remain unchanged
+            result += c;
+        }
+    }
+
+    return result;
+}
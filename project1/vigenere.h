@@ -0,0 +1,40 @@
+#ifndef VIGENERE_H
+#define VIGENERE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Key turned into per-letter shifts once, when PASS arrives.
+// Non-letters in the key carry no shift and are skipped.
+struct KeySchedule {
+    std::vector<uint8_t> encrypt_shifts;
+    std::vector<uint8_t> decrypt_shifts;
+
+    bool empty() const { return encrypt_shifts.empty(); }
+};
+
+KeySchedule build_key_schedule(std::string_view key);
+// Rebuilds into an existing schedule, reusing its storage
+void build_key_schedule(std::string_view key, KeySchedule& schedule);
+
+// Table-driven Vigenère over n bytes: one lookup per byte in a per-shift
+// 256-entry translation table, no division and no branch on the character.
+// Letters come out uppercase, everything else is copied unchanged.
+void vigenere_encrypt_into(const char* text, char* out, size_t n, const KeySchedule& schedule);
+void vigenere_decrypt_into(const char* text, char* out, size_t n, const KeySchedule& schedule);
+
+// Streaming variants: key_index carries the key position across calls
+void vigenere_encrypt_into(const char* text, char* out, size_t n, const KeySchedule& schedule, size_t& key_index);
+void vigenere_decrypt_into(const char* text, char* out, size_t n, const KeySchedule& schedule, size_t& key_index);
+
+// Number of letters in text, i.e. how far it advances the key
+size_t vigenere_key_advance(const char* text, size_t n);
+
+// Straightforward per-character reference versions
+std::string vingener_encrypt(const std::string& text, const std::string& key);
+std::string vigenere_decrypt(const std::string& text, const std::string& key);
+
+#endif
@@ -4,14 +4,39 @@
 #include <random>
 #include <chrono>
 #include <queue>
+#include <memory>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+#include <unistd.h>
 #include "semaphore.h"
+#include "semaphore_debug.h"
+#include "bank_stats.h"
+#include "trace.h"
 
 using namespace std;
 
 // --- Simulation Settings ---
+// A normal run simulates one day with these; soak mode picks new ones every day
 const int NUM_TELLERS = 3;
 const int NUM_CUSTOMERS = 50;
 const int MAX_SAFE_CAPACITY = 2; // How many tellers can be in the safe at once
+const int DOOR_CAPACITY = 2;
+const int WITHDRAWAL_PERCENT = 50;
+
+// Soak mode draws each day's settings from 1 up to these
+const int SOAK_MAX_TELLERS = 8;
+const int SOAK_MAX_CUSTOMERS = 200;
+const int SOAK_MAX_DOOR_CAPACITY = 4;
+
+// Longest a teller spends on one customer at sleep scale 1 (manager, then safe)
+const int SLOWEST_SERVICE_MS = 100;
+
+// Invariant violations printed; the rest are only counted
+const long MAX_VIOLATIONS_PRINTED = 20;
 
 // Simple way to identify transaction types
 enum TransactionType {
@@ -19,156 +44,229 @@ enum TransactionType {
     WITHDRAWAL
 };
 
-// --- Global Shared Resources & Synchronization Primitives ---
+// The settings of one simulated day
+struct DayConfig {
+    int tellers;
+    int customers;
+    int safeCapacity;
+    int doorCapacity;
+    int withdrawalPercent;
+};
 
-// Semaphores controlling access to shared resources
-Semaphore bankOpenSem(0);       
-Semaphore safeSem(MAX_SAFE_CAPACITY); 
-Semaphore managerSem(1);       
-Semaphore doorSem(2);          
-Semaphore printSem(1);         
+// --- Shared Resources & Synchronization Primitives of one day ---
+struct Bank {
+    DayConfig config;
+
+    // Semaphores controlling access to shared resources
+    Semaphore bankOpenSem;
+    Semaphore safeSem;
+    Semaphore managerSem;
+    Semaphore doorSem;
+
+    // Tools for handing customers to tellers. A teller with nothing to do
+    // joins readyTellers before signaling tellerAvailableSem, so a customer
+    // that gets past tellerAvailableSem always finds a teller waiting.
+    Semaphore queueMutex;
+    Semaphore tellerAvailableSem;
+    queue<int> readyTellers;
+
+    // The customer each teller is serving; -1 sends the teller home
+    vector<int> tellerCustomer;
+
+    // Semaphores for detailed step-by-step coordination between a specific teller and their assigned customer
+    vector<unique_ptr<Semaphore> > customerReadySem;
+    vector<unique_ptr<Semaphore> > askTransactionSem;
+    vector<unique_ptr<Semaphore> > tellTransactionSem;
+    vector<unique_ptr<Semaphore> > transactionDoneSem;
+    vector<unique_ptr<Semaphore> > customerLeaveSem;
+
+    // Stores the transaction type requested by the customer assigned to a specific teller
+    vector<TransactionType> customerTransactions;
+
+    // Keeping track of simulation progress (lock-free, one shard per teller)
+    BankStats stats;
+
+    // For the invariant checks
+    vector<atomic<int> > timesServed; // Per customer
+    atomic<int> tellersInSafe;
+    atomic<int> tellersWithManager;
+
+    explicit Bank(const DayConfig& config);
+};
 
-// Tools for managing the customer waiting line
-Semaphore queueMutex(1);       
-Semaphore tellerAvailableSem(0); 
-queue<int> customerQueue;
+Bank::Bank(const DayConfig& config)
+    : config(config),
+      bankOpenSem(0, "bankOpenSem"),
+      safeSem(config.safeCapacity, "safeSem"),
+      managerSem(1, "managerSem"),
+      doorSem(config.doorCapacity, "doorSem"),
+      queueMutex(1, "queueMutex"),
+      tellerAvailableSem(0, "tellerAvailableSem"),
+      tellerCustomer(config.tellers, -1),
+      customerTransactions(config.tellers),
+      timesServed(config.customers),
+      tellersInSafe(0),
+      tellersWithManager(0) {
+    for (int i = 0; i < config.tellers; i++) {
+        string index = "[" + to_string(i) + "]";
+        customerReadySem.push_back(unique_ptr<Semaphore>(new Semaphore(0, "customerReadySem" + index)));
+        askTransactionSem.push_back(unique_ptr<Semaphore>(new Semaphore(0, "askTransactionSem" + index)));
+        tellTransactionSem.push_back(unique_ptr<Semaphore>(new Semaphore(0, "tellTransactionSem" + index)));
+        transactionDoneSem.push_back(unique_ptr<Semaphore>(new Semaphore(0, "transactionDoneSem" + index)));
+        customerLeaveSem.push_back(unique_ptr<Semaphore>(new Semaphore(0, "customerLeaveSem" + index)));
+    }
+}
 
-// Tracking teller state
-vector<bool> tellerAvailable(NUM_TELLERS, false); 
-vector<int> tellerCustomer(NUM_TELLERS, -1);
+// --- Process-wide state ---
+Semaphore printSem(1, "printSem");
 
-// Semaphores for detailed step-by-step coordination between a specific teller and their assigned customer
-vector<Semaphore*> tellerReadySem;    
-vector<Semaphore*> customerReadySem;  
-vector<Semaphore*> askTransactionSem; 
-vector<Semaphore*> tellTransactionSem;
-vector<Semaphore*> transactionDoneSem;
-vector<Semaphore*> customerLeaveSem; 
+// Soak mode runs quietly and only reports progress
+bool narrate = true;
 
-// Stores the transaction type requested by the customer assigned to a specific teller
-vector<TransactionType> customerTransactions(NUM_TELLERS);
+// Multiplies every simulated delay; 0 only yields the processor
+double sleepScale = 1.0;
 
-// Keeping track of simulation progress
-int customersServed = 0;       
-Semaphore customerCountSem(1); 
+atomic<long> violations(0);
 
-// Random number generation for simulating variability
-mt19937 rng(chrono::steady_clock::now().time_since_epoch().count());
+// Random number generation for simulating variability, one generator per
+// thread (mt19937 is not thread-safe); --seed fixes the sequence of seeds
+atomic<unsigned> nextSeed(chrono::steady_clock::now().time_since_epoch().count());
+thread_local mt19937 rng(nextSeed++);
 
 // --- Helper Functions ---
 
+// Names the calling thread in traces and semaphore watchdog reports
+void nameThread(const string& name) {
+    TRACE_THREAD_NAME(name);
+    nameSemaphoreThread(name);
+}
+
 // Prints a message to the console safely from any thread
 void syncPrint(const string& msg) {
+    if (!narrate) return;
     printSem.wait();
     cout << msg << endl;
     printSem.signal();
 }
 
+// Records a broken invariant; printed whether or not the day is narrated
+void violation(const string& msg) {
+    if (++violations > MAX_VIOLATIONS_PRINTED) return;
+    printSem.wait();
+    cerr << "INVARIANT VIOLATED: " << msg << endl;
+    printSem.signal();
+}
+
 // Pauses the current thread for a random duration to simulate work/travel time
 void randomSleep(int min_ms, int max_ms) {
-    if (min_ms >= max_ms) {
-         if (min_ms > 0) this_thread::sleep_for(chrono::milliseconds(min_ms));
-         return;
+    if (sleepScale <= 0) {
+        this_thread::yield();
+        return;
+    }
+    int ms = min_ms;
+    if (min_ms < max_ms) {
+        uniform_int_distribution<int> dist(min_ms, max_ms);
+        ms = dist(rng);
+    }
+    if (ms > 0) this_thread::sleep_for(chrono::microseconds(lround(ms * 1000 * sleepScale)));
+}
+
+// Takes one of the safe's places, works inside and leaves
+void useSafe(Bank& bank, int id, const string& who) {
+    syncPrint(who + ": going to safe");
+    bank.safeSem.wait(); // Wait if safe capacity is reached
+    int inSafe = ++bank.tellersInSafe;
+    if (inSafe > bank.config.safeCapacity) {
+        violation(to_string(inSafe) + " tellers in a safe for " + to_string(bank.config.safeCapacity));
     }
-    uniform_int_distribution<int> dist(min_ms, max_ms);
-    this_thread::sleep_for(chrono::milliseconds(dist(rng)));
+    bank.stats.add(id, BankStats::SAFE_ENTRIES);
+    syncPrint(who + ": enter safe");
+    randomSleep(10, 50); // Simulate work inside the safe
+    syncPrint(who + ": leaving safe");
+    bank.tellersInSafe--;
+    bank.safeSem.signal(); // Release spot in the safe
 }
 
 // --- Teller Logic ---
 // This function defines the behavior of each teller thread
-void teller(int id) {
-    syncPrint("Teller " + to_string(id) + " []: ready to serve");    
-    bankOpenSem.signal();
+void teller(Bank& bank, int id) {
+    nameThread("teller " + to_string(id));
+    syncPrint("Teller " + to_string(id) + " []: ready to serve");
+    bank.bankOpenSem.signal();
     while (true) {
         syncPrint("Teller " + to_string(id) + " []: waiting for a customer");
-        queueMutex.wait();
-        tellerAvailable[id] = true;
-
-        if (!customerQueue.empty()) {
-            int customerId = customerQueue.front();
-            customerQueue.pop();
-            tellerCustomer[id] = customerId; 
-            tellerAvailable[id] = false;     
-            queueMutex.signal();             
-            tellerReadySem[id]->signal();
-            customerReadySem[id]->wait();
-        } else {
-            queueMutex.signal();
-            tellerAvailableSem.signal();
-            tellerReadySem[id]->wait();
-            customerReadySem[id]->wait();
-            queueMutex.wait();
-            if (tellerCustomer[id] == -1) { 
-                queueMutex.signal();
-                break;
-            }
-            queueMutex.signal();
-        }
+        bank.queueMutex.wait();
+        bank.readyTellers.push(id);
+        bank.queueMutex.signal();
+        bank.tellerAvailableSem.signal();
 
-        int custId = tellerCustomer[id];
+        // Wait for a customer to pick this teller, or for closing time
+        bank.customerReadySem[id]->wait();
+        int custId = bank.tellerCustomer[id];
+        if (custId == -1) break;
+
+        string who = "Teller " + to_string(id) + " [Customer " + to_string(custId) + "]";
 
         // ---- Serve the customer ----
-        syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: serving a customer");
+        syncPrint(who + ": serving a customer");
 
         // Coordinate asking for the transaction type
-        syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: asks for transaction");
-        askTransactionSem[id]->signal();
-        tellTransactionSem[id]->wait(); 
+        syncPrint(who + ": asks for transaction");
+        bank.askTransactionSem[id]->signal();
+        bank.tellTransactionSem[id]->wait();
 
         // Retrieve the transaction type the customer provided
-        TransactionType transType = customerTransactions[id];
+        TransactionType transType = bank.customerTransactions[id];
 
         // ---- Perform the transaction ----
         if (transType == DEPOSIT) {
-            syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: handling deposit transaction");
-            syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: going to safe");
-            safeSem.wait(); // Wait if safe capacity is reached
-            syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: enter safe");
-            randomSleep(10, 50); // Simulate work inside the safe
-            syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: leaving safe");
-            safeSem.signal(); // Release spot in the safe
-            syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: finishes deposit transaction.");
+            syncPrint(who + ": handling deposit transaction");
+            useSafe(bank, id, who);
+            syncPrint(who + ": finishes deposit transaction.");
+            bank.stats.add(id, BankStats::DEPOSITS);
         } else { // WITHDRAWAL
-            syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: handling withdrawal transaction");
-            
+            syncPrint(who + ": handling withdrawal transaction");
+
             // Access the manager (shared resource)
-            syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: going to the manager");
-            managerSem.wait(); // Wait if manager is busy
-            syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: getting manager's permission");
+            syncPrint(who + ": going to the manager");
+            bank.managerSem.wait(); // Wait if manager is busy
+            int withManager = ++bank.tellersWithManager;
+            if (withManager > 1) {
+                violation(to_string(withManager) + " tellers with the manager at once");
+            }
+            syncPrint(who + ": getting manager's permission");
             randomSleep(5, 30); // Simulate talking to the manager
-            syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: got manager's permission");
-            managerSem.signal(); // Release the manager
+            syncPrint(who + ": got manager's permission");
+            bank.stats.add(id, BankStats::MANAGER_APPROVALS);
+            bank.tellersWithManager--;
+            bank.managerSem.signal(); // Release the manager
 
             // Access the safe (shared resource)
-            syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: going to safe");
-            safeSem.wait(); // Wait if safe capacity is reached
-            syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: enter safe");
-            randomSleep(10, 50); // Simulate work inside the safe
-            syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: leaving safe");
-            safeSem.signal(); // Release spot in the safe
-
-            syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: finishes withdrawal transaction.");
+            useSafe(bank, id, who);
+
+            syncPrint(who + ": finishes withdrawal transaction.");
+            bank.stats.add(id, BankStats::WITHDRAWALS);
         }
 
         // ---- Finalize interaction ----
-        syncPrint("Teller " + to_string(id) + " [Customer " + to_string(custId) + "]: wait for customer to leave.");
-        transactionDoneSem[id]->signal(); 
-        customerLeaveSem[id]->wait();   
+        syncPrint(who + ": wait for customer to leave.");
+        bank.transactionDoneSem[id]->signal();
+        bank.customerLeaveSem[id]->wait();
 
         // ---- Update overall count ----
-        customerCountSem.wait();
-        customersServed++;
-        customerCountSem.signal();
+        bank.stats.add(id, BankStats::SERVED);
+        bank.timesServed[custId]++;
     }
 
     syncPrint("Teller " + to_string(id) + " []: leaving for the day");
 }
 
 // --- Customer Logic ---
-void customer(int id) {
+void customer(Bank& bank, int id) {
+    nameThread("customer " + to_string(id));
     // Customer decides what they want to do
-    uniform_int_distribution<int> transaction_dist(0, 1);
-    TransactionType transactionType = static_cast<TransactionType>(transaction_dist(rng));
+    uniform_int_distribution<int> percent(0, 99);
+    TransactionType transactionType = percent(rng) < bank.config.withdrawalPercent ? WITHDRAWAL : DEPOSIT;
 
     if (transactionType == DEPOSIT) {
         syncPrint("Customer " + to_string(id) + " []: wants to perform a deposit transaction");
@@ -181,166 +279,287 @@ void customer(int id) {
     syncPrint("Customer " + to_string(id) + " []: going to bank.");
 
     // Use the 'door' semaphore to potentially limit entry rate
-    doorSem.wait();
+    bank.doorSem.wait();
     syncPrint("Customer " + to_string(id) + " []: entering bank.");
-    doorSem.signal(); 
+    bank.doorSem.signal();
 
     syncPrint("Customer " + to_string(id) + " []: getting in line.");
 
     // --- Find a teller ---
-    int assignedTeller = -1;
-
-    queueMutex.wait(); 
-    // Check if any teller is marked as available right now
-    for (int i = 0; i < NUM_TELLERS; i++) {
-        if (tellerAvailable[i]) {
-            assignedTeller = i;          
-            tellerAvailable[i] = false;  
-            tellerCustomer[i] = id;      
-            break;                      
-        }
-    }
-
-    if (assignedTeller == -1) {
-        // No teller was free, so join the queue
-        customerQueue.push(id);
-        queueMutex.signal(); 
-
-        // Wait for the signal that *some* teller is available
-        tellerAvailableSem.wait();
-
-        // Woke up! Now need to find which teller became free.
-        // WARNING: Race condition potential here! Another customer might grab the teller first.
-        queueMutex.wait(); 
-        for (int i = 0; i < NUM_TELLERS; i++) {
-            if (tellerAvailable[i]) {
-                assignedTeller = i;
-                tellerAvailable[i] = false;
-                tellerCustomer[i] = id;
-                break;
-            }
-        }
-        // It's possible assignedTeller is still -1 if another customer was faster,
-        // but this code assumes it finds one.
-        queueMutex.signal(); 
-    } else {
-        // Found a teller immediately in the first check
-        queueMutex.signal(); 
-    }
+    // Each signal of tellerAvailableSem stands for one teller in readyTellers,
+    // so no other customer can take the teller this one was woken for
+    bank.tellerAvailableSem.wait();
+    bank.queueMutex.wait();
+    int assignedTeller = bank.readyTellers.front();
+    bank.readyTellers.pop();
+    bank.tellerCustomer[assignedTeller] = id;
+    bank.queueMutex.signal();
 
     // --- Interact with the assigned teller ---
-    syncPrint("Customer " + to_string(id) + " []: selecting a teller."); 
+    syncPrint("Customer " + to_string(id) + " []: selecting a teller.");
     // Specific messages for the interaction
     syncPrint("Customer " + to_string(id) + " [Teller " + to_string(assignedTeller) + "]: selects teller");
     syncPrint("Customer " + to_string(id) + " [Teller " + to_string(assignedTeller) + "] introduces itself");
 
     // Coordinate arrival at the window
-    tellerReadySem[assignedTeller]->signal();   
-    customerReadySem[assignedTeller]->signal(); 
+    bank.customerReadySem[assignedTeller]->signal();
 
     // Wait for the teller to ask what we want
-    askTransactionSem[assignedTeller]->wait();
+    bank.askTransactionSem[assignedTeller]->wait();
 
     // Tell the teller the transaction type
     syncPrint("Customer " + to_string(id) + " [Teller " + to_string(assignedTeller) +
               "]: asks for " + (transactionType == DEPOSIT ? "deposit" : "withdrawal") + " transaction");
     // Store transaction type where teller can find it (indexed by teller ID)
-    customerTransactions[assignedTeller] = transactionType;
-    tellTransactionSem[assignedTeller]->signal(); 
+    bank.customerTransactions[assignedTeller] = transactionType;
+    bank.tellTransactionSem[assignedTeller]->signal();
 
     // Wait for the teller to finish the transaction
-    transactionDoneSem[assignedTeller]->wait();
+    bank.transactionDoneSem[assignedTeller]->wait();
 
     // --- Leave the teller window ---
     syncPrint("Customer " + to_string(id) + " [Teller " + to_string(assignedTeller) + "]: leaves teller");
-    customerLeaveSem[assignedTeller]->signal(); 
+    bank.customerLeaveSem[assignedTeller]->signal();
 
     // --- Leave the bank ---
     syncPrint("Customer " + to_string(id) + " []: goes to door");
     syncPrint("Customer " + to_string(id) + " []: leaves the bank");
 }
 
-// --- Main Program Entry Point ---
-int main() {
-    // IMPORTANT: Manually allocate semaphores because Semaphore class is not copyable
-    for (int i = 0; i < NUM_TELLERS; i++) {
-        tellerReadySem.push_back(new Semaphore(0));
-        customerReadySem.push_back(new Semaphore(0));
-        askTransactionSem.push_back(new Semaphore(0));
-        tellTransactionSem.push_back(new Semaphore(0));
-        transactionDoneSem.push_back(new Semaphore(0));
-        customerLeaveSem.push_back(new Semaphore(0));
+// Checks what can only be checked once everyone has gone home
+void checkDay(Bank& bank) {
+    for (int i = 0; i < bank.config.customers; i++) {
+        if (bank.timesServed[i] != 1) {
+            violation("customer " + to_string(i) + " served " + to_string(bank.timesServed[i].load()) + " times");
+        }
+    }
+    long served = bank.stats.total(BankStats::SERVED);
+    long transactions = bank.stats.total(BankStats::DEPOSITS) + bank.stats.total(BankStats::WITHDRAWALS);
+    if (served != bank.config.customers || transactions != served) {
+        violation(to_string(bank.config.customers) + " customers but " + bank.stats.summary());
     }
+    if (bank.stats.total(BankStats::MANAGER_APPROVALS) != bank.stats.total(BankStats::WITHDRAWALS)) {
+        violation("withdrawals without manager approval: " + bank.stats.summary());
+    }
+}
+
+// Opens the bank, lets every customer through, closes and checks the
+// invariants. Returns the number of customers served.
+long runDay(const DayConfig& config) {
+    Bank bank(config);
 
     // Create and launch the teller threads
     vector<thread> tellerThreads;
-    for (int i = 0; i < NUM_TELLERS; i++) {
-        tellerThreads.push_back(thread(teller, i));
+    for (int i = 0; i < config.tellers; i++) {
+        tellerThreads.push_back(thread(teller, ref(bank), i));
     }
 
     // Wait until all tellers have signaled they are ready
-    for (int i = 0; i < NUM_TELLERS; i++) {
-        bankOpenSem.wait();
+    for (int i = 0; i < config.tellers; i++) {
+        bank.bankOpenSem.wait();
     }
-    syncPrint("Bank is open!"); 
+    syncPrint("Bank is open!");
 
     // Create and launch the customer threads
     vector<thread> customerThreads;
-    for (int i = 0; i < NUM_CUSTOMERS; i++) {
-        customerThreads.push_back(thread(customer, i));
-        randomSleep(1, 10); 
+    for (int i = 0; i < config.customers; i++) {
+        customerThreads.push_back(thread(customer, ref(bank), i));
+        randomSleep(1, 10);
     }
 
     // Wait for all customer threads to complete their lifecycle
-    for (int i = 0; i < NUM_CUSTOMERS; i++) {
-        if(customerThreads[i].joinable()) {
-             customerThreads[i].join();
-        }
+    for (int i = 0; i < config.customers; i++) {
+        customerThreads[i].join();
     }
-    syncPrint("All customers have finished."); 
+    syncPrint("All customers have finished.");
 
     // --- Simulation End Sequence ---
-    // Signal tellers that it's time to shut down
-    queueMutex.wait();
-    for (int i = 0; i < NUM_TELLERS; i++) {
-        tellerAvailable[i] = true; 
-        tellerCustomer[i] = -1;    
-    }
-    queueMutex.signal();
-
-    // Wake up any tellers that might be stuck waiting for customers
-    for (int i = 0; i < NUM_TELLERS; i++) {
-        // Signal the semaphores tellers might be waiting on in their loop
-        tellerReadySem[i]->signal();
-        customerReadySem[i]->signal();
+    // Send every teller home the way a customer would reach them
+    for (int i = 0; i < config.tellers; i++) {
+        bank.tellerAvailableSem.wait();
+        bank.queueMutex.wait();
+        int tellerId = bank.readyTellers.front();
+        bank.readyTellers.pop();
+        bank.tellerCustomer[tellerId] = -1;
+        bank.queueMutex.signal();
+        bank.customerReadySem[tellerId]->signal();
     }
 
     // Wait for all teller threads to finish their shutdown process
-    for (int i = 0; i < NUM_TELLERS; i++) {
-         if(tellerThreads[i].joinable()) { 
-             tellerThreads[i].join();
-         }
+    for (int i = 0; i < config.tellers; i++) {
+        tellerThreads[i].join();
     }
 
     syncPrint("The bank closes for the day.");
+    syncPrint("Statistics: " + bank.stats.summary());
+    checkDay(bank);
+    return bank.stats.total(BankStats::SERVED);
+}
+
+// --- Soak Mode ---
+
+struct SoakOptions {
+    double seconds;       // Stop after this long...
+    long days;            // ...or this many days, if not 0
+    double reportSeconds; // Progress line interval
+};
 
-    // --- IMPORTANT: Clean up dynamically allocated memory ---
-    // Delete the semaphores created with 'new' to prevent memory leaks
-    for (int i = 0; i < NUM_TELLERS; i++) {
-        delete tellerReadySem[i];
-        delete customerReadySem[i];
-        delete askTransactionSem[i];
-        delete tellTransactionSem[i];
-        delete transactionDoneSem[i];
-        delete customerLeaveSem[i];
+// Resident set size in KB; the peak where /proc is missing
+long residentKb() {
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL) {
+        long size, resident;
+        int fields = fscanf(statm, "%ld %ld", &size, &resident);
+        fclose(statm);
+        if (fields == 2) return resident * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // Bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+// Runs randomized days back to back. Throughput and memory are reported
+// against the first interval, so a leak or a scaling regression shows up
+// as steady growth or drift over the run.
+int soak(const SoakOptions& options) {
+    mt19937 dayRng(nextSeed++);
+    uniform_int_distribution<int> tellerCount(1, SOAK_MAX_TELLERS);
+    uniform_int_distribution<int> customerCount(1, SOAK_MAX_CUSTOMERS);
+    uniform_int_distribution<int> doorCapacity(1, SOAK_MAX_DOOR_CAPACITY);
+    uniform_int_distribution<int> withdrawalPercent(0, 100);
+
+    auto start = chrono::steady_clock::now();
+    auto lastReport = start;
+    long days = 0, served = 0, servedAtLastReport = 0;
+    double firstRate = 0;
+    long firstKb = 0;
+
+    printf("soak: %.0f s%s, tellers 1-%d, customers 1-%d, sleep scale %g\n", options.seconds,
+           options.days > 0 ? (" or " + to_string(options.days) + " days").c_str() : "",
+           SOAK_MAX_TELLERS, SOAK_MAX_CUSTOMERS, sleepScale);
+    fflush(stdout);
+
+    bool done = false;
+    while (!done) {
+        DayConfig config;
+        config.tellers = tellerCount(dayRng);
+        config.customers = customerCount(dayRng);
+        config.safeCapacity = uniform_int_distribution<int>(1, config.tellers)(dayRng);
+        config.doorCapacity = doorCapacity(dayRng);
+        config.withdrawalPercent = withdrawalPercent(dayRng);
+        served += runDay(config);
+        days++;
+
+        auto now = chrono::steady_clock::now();
+        double elapsed = chrono::duration<double>(now - start).count();
+        done = elapsed >= options.seconds || (options.days > 0 && days >= options.days);
+        double interval = chrono::duration<double>(now - lastReport).count();
+        if (interval < options.reportSeconds && !done) continue;
+
+        double rate = (served - servedAtLastReport) / interval;
+        long kb = residentKb();
+        if (firstKb == 0) {
+            firstRate = rate;
+            firstKb = kb;
+        }
+        printf("soak: %7.0f s  days %ld  served %ld  %.0f customers/s (%+.1f%%)  rss %ld KB (%+ld KB)  violations %ld\n",
+               elapsed, days, served, rate, firstRate > 0 ? (rate / firstRate - 1) * 100 : 0.0,
+               kb, kb - firstKb, violations.load());
+        fflush(stdout);
+        lastReport = now;
+        servedAtLastReport = served;
     }
-    // Clear the vectors of pointers (optional, but good practice)
-    tellerReadySem.clear();
-    customerReadySem.clear();
-    askTransactionSem.clear();
-    tellTransactionSem.clear();
-    transactionDoneSem.clear();
-    customerLeaveSem.clear();
 
+    if (violations > 0) {
+        fprintf(stderr, "soak: %ld invariant violations\n", violations.load());
+        return 1;
+    }
+    printf("soak: passed\n");
     return 0;
-}
\ No newline at end of file
+}
+
+// Parses "90", "90s", "30m" or "8h" into seconds; negative if malformed
+double parseDuration(const char* text) {
+    char* end;
+    double value = strtod(text, &end);
+    if (end == text || value < 0) return -1;
+    if (*end == '\0' || strcmp(end, "s") == 0) return value;
+    if (strcmp(end, "m") == 0) return value * 60;
+    if (strcmp(end, "h") == 0) return value * 3600;
+    return -1;
+}
+
+void usage(const char* program) {
+    cerr << "Usage: " << program << " [--seed n] [--sleep-scale x]\n"
+         << "       " << program << " --soak [--duration t] [--days n] [--report t] [--seed n] [--sleep-scale x]\n"
+         << "  --soak         run randomized days back to back, checking invariants\n"
+         << "  --duration t   soak for t (90s, 30m, 8h; default 1h)\n"
+         << "  --days n       stop the soak after n days\n"
+         << "  --report t     progress interval (default 60s)\n"
+         << "  --seed n       seed for the random choices\n"
+         << "  --sleep-scale  multiply simulated delays by x (default 1, 0 in a soak)" << endl;
+}
+
+// --- Main Program Entry Point ---
+int main(int argc, char* argv[]) {
+    TRACE_INIT("bank_simulation");
+    nameThread("main");
+
+    bool soakMode = false;
+    bool scaleGiven = false;
+    SoakOptions options;
+    options.seconds = 3600;
+    options.days = 0;
+    options.reportSeconds = 60;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--soak") {
+            soakMode = true;
+        } else if (arg == "--duration" && hasValue) {
+            options.seconds = parseDuration(argv[++i]);
+        } else if (arg == "--report" && hasValue) {
+            options.reportSeconds = parseDuration(argv[++i]);
+        } else if (arg == "--days" && hasValue) {
+            options.days = atol(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            nextSeed = strtoul(argv[++i], NULL, 10);
+        } else if (arg == "--sleep-scale" && hasValue) {
+            sleepScale = atof(argv[++i]);
+            scaleGiven = true;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.seconds < 0 || options.reportSeconds < 0 || options.days < 0 || sleepScale < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!soakMode) {
+        // Reports threads stuck in a semaphore (SEMAPHORE_DEBUG builds) for
+        // longer than the slowest customer could have to queue
+        startSemaphoreWatchdog(1000 + static_cast<int>(sleepScale * NUM_CUSTOMERS * SLOWEST_SERVICE_MS / NUM_TELLERS));
+        DayConfig config;
+        config.tellers = NUM_TELLERS;
+        config.customers = NUM_CUSTOMERS;
+        config.safeCapacity = MAX_SAFE_CAPACITY;
+        config.doorCapacity = DOOR_CAPACITY;
+        config.withdrawalPercent = WITHDRAWAL_PERCENT;
+        runDay(config);
+        stopSemaphoreWatchdog();
+        return violations > 0 ? 1 : 0;
+    }
+
+    narrate = false;
+    if (!scaleGiven) sleepScale = 0;
+    startSemaphoreWatchdog(1000 + static_cast<int>(sleepScale * SOAK_MAX_CUSTOMERS * SLOWEST_SERVICE_MS));
+    int status = soak(options);
+    stopSemaphoreWatchdog();
+    return status;
+}
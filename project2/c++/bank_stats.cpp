@@ -0,0 +1,46 @@
+#include "bank_stats.h"
+
+BankStats::BankStats() {
+    reset();
+}
+
+void BankStats::add(int shard, Counter counter, long amount) {
+    _shards[shard % MAX_SHARDS].counts[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+long BankStats::total(Counter counter) const {
+    long sum = 0;
+    for (int i = 0; i < MAX_SHARDS; i++) {
+        sum += _shards[i].counts[counter].load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+void BankStats::reset() {
+    for (int i = 0; i < MAX_SHARDS; i++) {
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+            _shards[i].counts[c].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+std::string BankStats::summary() const {
+    std::string out;
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+        if (!out.empty()) out += ", ";
+        out += name(static_cast<Counter>(c));
+        out += "=" + std::to_string(total(static_cast<Counter>(c)));
+    }
+    return out;
+}
+
+const char* BankStats::name(Counter counter) {
+    switch (counter) {
+        case SERVED: return "served";
+        case DEPOSITS: return "deposits";
+        case WITHDRAWALS: return "withdrawals";
+        case SAFE_ENTRIES: return "safe_entries";
+        case MANAGER_APPROVALS: return "manager_approvals";
+        default: return "unknown";
+    }
+}
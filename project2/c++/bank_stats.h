@@ -0,0 +1,36 @@
+#ifndef __BANK_STATS_H_
+#define __BANK_STATS_H_
+#include <atomic>
+#include <string>
+
+// Simulation statistics kept as sharded relaxed atomics. Each teller bumps
+// its own cache-line padded shard, so the hot path never takes a lock or
+// bounces a shared line between cores; readers sum the shards.
+class BankStats {
+    public:
+        enum Counter {
+            SERVED,
+            DEPOSITS,
+            WITHDRAWALS,
+            SAFE_ENTRIES,
+            MANAGER_APPROVALS,
+            NUM_COUNTERS
+        };
+
+        // Threads with ids beyond this share shards (id % MAX_SHARDS)
+        static const int MAX_SHARDS = 16;
+
+        BankStats();
+        void add(int shard, Counter counter, long amount = 1);
+        long total(Counter counter) const;
+        void reset();
+        std::string summary() const;
+        static const char* name(Counter counter);
+
+    private:
+        struct alignas(64) Shard {
+            std::atomic<long> counts[NUM_COUNTERS];
+        };
+        Shard _shards[MAX_SHARDS];
+};
+#endif
@@ -1,12 +1,47 @@
 #include "semaphore.h"
+#include "semaphore_debug.h"
+#include "trace.h"
+
+Semaphore::Semaphore(const std::string& name) : _count(0), _init(false), _name(name) {
+#ifdef SEMAPHORE_DEBUG
+    _initial = 0;
+    _waiters = 0;
+    for (int i = 0; i < MAX_HOLDERS; i++) _holders[i] = 0;
+    _nextHolder = 0;
+    _lastSignaler = 0;
+    _lastSignalNs = 0;
+    SemaphoreRegistry::add(this);
+#endif
+}
+
+Semaphore::Semaphore(int init, const std::string& name) : Semaphore(name) {
+    _count = init;
+    _init = true;
+#ifdef SEMAPHORE_DEBUG
+    _initial = init;
+#endif
+}
+
+Semaphore::~Semaphore() {
+#ifdef SEMAPHORE_DEBUG
+    SemaphoreRegistry::remove(this);
+#endif
+}
 
 void Semaphore::initialize(int value) {
     if(_init) throw reinit_error();
     _init = true;
     _count = value;
+#ifdef SEMAPHORE_DEBUG
+    std::lock_guard<std::mutex> lock(_semLock);
+    _initial = value;
+#endif
 }
 
+#ifndef SEMAPHORE_DEBUG
+
 void Semaphore::wait() {
+    TRACE_SPAN("Semaphore::wait", "semaphore");
     std::unique_lock<std::mutex> lock(_semLock);
     while(_count <= 0) _signaled.wait(lock);
     _count--;
@@ -17,3 +52,43 @@ void Semaphore::signal() {
     _count++;
     _signaled.notify_one();
 }
+
+#else
+
+// Same as above, plus what the watchdog needs: who is blocked here and
+// since when, who holds the semaphore and who signaled it last
+void Semaphore::wait() {
+    TRACE_SPAN("Semaphore::wait", "semaphore");
+    SemaphoreThread* self = SemaphoreRegistry::currentThread();
+    std::unique_lock<std::mutex> lock(_semLock);
+    if(_count <= 0) {
+        _waiters++;
+        self->sinceNs.store(SemaphoreRegistry::nowNs(), std::memory_order_relaxed);
+        self->waits.fetch_add(1, std::memory_order_relaxed);
+        self->waitingOn.store(this, std::memory_order_release);
+        while(_count <= 0) _signaled.wait(lock);
+        self->waitingOn.store(NULL, std::memory_order_relaxed);
+        _waiters--;
+    }
+    _count--;
+    _holders[_nextHolder] = self->serial;
+    _nextHolder = (_nextHolder + 1) % MAX_HOLDERS;
+}
+
+void Semaphore::signal() {
+    SemaphoreThread* self = SemaphoreRegistry::currentThread();
+    int64_t now = SemaphoreRegistry::nowNs();
+    std::lock_guard<std::mutex> lock(_semLock);
+    _count++;
+    for (int i = 0; i < MAX_HOLDERS; i++) {
+        if (_holders[i] == self->serial) {
+            _holders[i] = 0;
+            break;
+        }
+    }
+    _lastSignaler = self->serial;
+    _lastSignalNs = now;
+    _signaled.notify_one();
+}
+
+#endif
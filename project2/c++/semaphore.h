@@ -3,14 +3,24 @@
 #include <mutex>
 #include <condition_variable>
 #include <exception>
+#include <string>
+#ifdef SEMAPHORE_DEBUG
+#include <cstdint>
+#endif
 
+// Built with -DSEMAPHORE_DEBUG, every Semaphore registers itself under its
+// name and records who waits on it, so the watchdog in semaphore_debug.h
+// can report stalls and wait-for cycles. The whole program must be built
+// the same way: the debug fields change the class layout.
 class Semaphore {
     public:
-        Semaphore() : _init(false) {}
-        Semaphore(int init) : _init(true), _count(init) {}
+        Semaphore(const std::string& name = "");
+        Semaphore(int init, const std::string& name = "");
+        ~Semaphore();
         void initialize(int value);
         void wait();
         void signal();
+        const std::string& name() const { return _name; }
         class reinit_error : std::exception {
             public:
                 const char* what() const noexcept {
@@ -22,5 +32,18 @@ class Semaphore {
         std::condition_variable _signaled;
         int _count;
         bool _init;
+        std::string _name;
+#ifdef SEMAPHORE_DEBUG
+        friend class SemaphoreRegistry;
+        // Threads (by debug serial) that passed wait() and have not signaled
+        // since; for semaphores used as locks these are the holders
+        static const int MAX_HOLDERS = 4;
+        int _initial;
+        int _waiters;
+        uint64_t _holders[MAX_HOLDERS];
+        int _nextHolder;
+        uint64_t _lastSignaler;
+        int64_t _lastSignalNs;
+#endif
 };
 #endif
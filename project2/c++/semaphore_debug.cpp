@@ -0,0 +1,329 @@
+#ifdef SEMAPHORE_DEBUG
+
+#include "semaphore.h"
+#include "semaphore_debug.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <set>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Semaphores with unconsumed signals listed per report
+const size_t MAX_UNCONSUMED_LISTED = 8;
+
+namespace {
+
+typedef std::pair<uint64_t, uint64_t> WaitKey;  // Thread serial, its wait count
+
+struct Registry {
+    std::mutex lock;
+    std::unordered_set<Semaphore*> semaphores;
+    std::vector<SemaphoreThread*> threads;
+    uint64_t nextSerial;
+    // Stalls and cycles already reported, kept while they last
+    std::set<WaitKey> reportedStalls;
+    std::set<std::vector<WaitKey> > reportedCycles;
+
+    Registry() : nextSerial(1) {}
+};
+
+// Never destroyed: global semaphores unregister during static destruction
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+// Drops the calling thread's record when the thread exits
+struct ThreadRecord {
+    SemaphoreThread* thread;
+
+    ThreadRecord() : thread(NULL) {}
+    ~ThreadRecord() {
+        if (thread == NULL) return;
+        Registry& r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        for (size_t i = 0; i < r.threads.size(); i++) {
+            if (r.threads[i] == thread) {
+                r.threads.erase(r.threads.begin() + i);
+                break;
+            }
+        }
+        delete thread;
+    }
+};
+
+thread_local ThreadRecord current;
+
+struct Watchdog {
+    std::mutex lock;
+    std::condition_variable stopping;
+    bool running;
+    std::thread thread;
+
+    Watchdog() : running(false) {}
+};
+
+Watchdog& watchdog() {
+    static Watchdog* instance = new Watchdog();
+    return *instance;
+}
+
+std::string seconds(int64_t ns) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.1f s", ns / 1e9);
+    return text;
+}
+
+std::string semaphoreName(const Semaphore* sem) {
+    if (!sem->name().empty()) return sem->name();
+    char text[32];
+    snprintf(text, sizeof(text), "semaphore %p", static_cast<const void*>(sem));
+    return text;
+}
+
+}  // namespace
+
+void SemaphoreRegistry::add(Semaphore* sem) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    r.semaphores.insert(sem);
+}
+
+void SemaphoreRegistry::remove(Semaphore* sem) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    r.semaphores.erase(sem);
+}
+
+SemaphoreThread* SemaphoreRegistry::currentThread() {
+    if (current.thread == NULL) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        current.thread = new SemaphoreThread(r.nextSerial++);
+        r.threads.push_back(current.thread);
+    }
+    return current.thread;
+}
+
+// Stall times are reported to a tenth of a second, so the coarse clock
+// (a few ms resolution, a fraction of the cost) is good enough
+int64_t SemaphoreRegistry::nowNs() {
+#ifdef CLOCK_MONOTONIC_COARSE
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void SemaphoreRegistry::scan(int64_t thresholdNs) {
+    Registry& r = registry();
+    // Semaphores lock after the registry; wait() and signal() never take
+    // the registry lock while holding a semaphore's
+    std::lock_guard<std::mutex> guard(r.lock);
+    int64_t now = nowNs();
+
+    struct Snapshot {
+        int value;
+        int initial;
+        int waiters;
+        uint64_t holders[Semaphore::MAX_HOLDERS];
+        uint64_t lastSignaler;
+        int64_t lastSignalNs;
+    };
+    auto snapshot = [](Semaphore* sem) -> Snapshot {
+        std::lock_guard<std::mutex> lock(sem->_semLock);
+        Snapshot s;
+        s.value = sem->_count;
+        s.initial = sem->_initial;
+        s.waiters = sem->_waiters;
+        for (int i = 0; i < Semaphore::MAX_HOLDERS; i++) s.holders[i] = sem->_holders[i];
+        s.lastSignaler = sem->_lastSignaler;
+        s.lastSignalNs = sem->_lastSignalNs;
+        return s;
+    };
+
+    std::map<uint64_t, const SemaphoreThread*> threads;
+    for (size_t i = 0; i < r.threads.size(); i++) {
+        threads[r.threads[i]->serial] = r.threads[i];
+    }
+    auto threadName = [&threads](uint64_t serial) -> std::string {
+        std::map<uint64_t, const SemaphoreThread*>::const_iterator it = threads.find(serial);
+        if (it == threads.end()) return "thread #" + std::to_string(serial) + " (exited)";
+        if (it->second->name.empty()) return "thread #" + std::to_string(serial);
+        return it->second->name;
+    };
+
+    // Threads blocked past the threshold
+    struct Stall {
+        WaitKey key;
+        Semaphore* sem;
+        int64_t waitedNs;
+        Snapshot state;
+    };
+    std::vector<Stall> stalls;
+    std::map<uint64_t, size_t> stalledThreads;
+    for (size_t i = 0; i < r.threads.size(); i++) {
+        SemaphoreThread* thread = r.threads[i];
+        Semaphore* sem = thread->waitingOn.load(std::memory_order_acquire);
+        if (sem == NULL || r.semaphores.count(sem) == 0) continue;
+        int64_t waited = now - thread->sinceNs.load(std::memory_order_relaxed);
+        if (waited < thresholdNs) continue;
+        Stall stall;
+        stall.key = WaitKey(thread->serial, thread->waits.load(std::memory_order_relaxed));
+        stall.sem = sem;
+        stall.waitedNs = waited;
+        stall.state = snapshot(sem);
+        stalledThreads[thread->serial] = stalls.size();
+        stalls.push_back(stall);
+    }
+
+    std::set<WaitKey> stillStalled;
+    bool reported = false;
+    for (size_t i = 0; i < stalls.size(); i++) {
+        const Stall& stall = stalls[i];
+        stillStalled.insert(stall.key);
+        if (r.reportedStalls.count(stall.key)) continue;
+        reported = true;
+
+        const Snapshot& s = stall.state;
+        std::string line = threadName(stall.key.first) + " has waited " + seconds(stall.waitedNs) +
+                           " on " + semaphoreName(stall.sem) + " (value " + std::to_string(s.value) +
+                           ", " + std::to_string(s.waiters) + " waiting";
+        std::string holders;
+        for (int h = 0; h < Semaphore::MAX_HOLDERS; h++) {
+            if (s.holders[h] != 0 && s.holders[h] != stall.key.first && threads.count(s.holders[h])) {
+                holders += (holders.empty() ? "" : ", ") + threadName(s.holders[h]);
+            }
+        }
+        if (!holders.empty()) line += ", held by " + holders;
+        if (s.lastSignaler != 0) {
+            line += ", last signaled " + seconds(now - s.lastSignalNs) + " ago by " + threadName(s.lastSignaler);
+        } else {
+            line += ", never signaled";
+        }
+        fprintf(stderr, "semaphore watchdog: %s)\n", line.c_str());
+    }
+    r.reportedStalls.swap(stillStalled);
+
+    // Wait-for cycles among the stalled threads: an edge runs from a thread
+    // to each thread holding the semaphore it waits on
+    std::vector<std::vector<size_t> > edges(stalls.size());
+    for (size_t i = 0; i < stalls.size(); i++) {
+        for (int h = 0; h < Semaphore::MAX_HOLDERS; h++) {
+            std::map<uint64_t, size_t>::const_iterator it = stalledThreads.find(stalls[i].state.holders[h]);
+            if (it != stalledThreads.end() && it->second != i) edges[i].push_back(it->second);
+        }
+    }
+    std::set<std::vector<WaitKey> > cycles;
+    std::vector<int> visited(stalls.size(), 0);  // 0 unvisited, 1 on the path, 2 done
+    std::vector<size_t> path;
+    std::function<void(size_t)> visit = [&](size_t i) {
+        visited[i] = 1;
+        path.push_back(i);
+        for (size_t e = 0; e < edges[i].size(); e++) {
+            size_t next = edges[i][e];
+            if (visited[next] == 1) {
+                // Start the cycle at its lowest serial so it is reported once
+                std::vector<size_t>::iterator start = std::find(path.begin(), path.end(), next);
+                std::vector<size_t> cycle(start, path.end());
+                std::rotate(cycle.begin(), std::min_element(cycle.begin(), cycle.end(),
+                    [&](size_t a, size_t b) { return stalls[a].key < stalls[b].key; }), cycle.end());
+                std::vector<WaitKey> key;
+                for (size_t c = 0; c < cycle.size(); c++) key.push_back(stalls[cycle[c]].key);
+                cycles.insert(key);
+                if (r.reportedCycles.count(key)) continue;
+                reported = true;
+
+                std::string line;
+                for (size_t c = 0; c < cycle.size(); c++) {
+                    const Stall& stall = stalls[cycle[c]];
+                    const Stall& holder = stalls[cycle[(c + 1) % cycle.size()]];
+                    line += (c == 0 ? "" : "; ") + threadName(stall.key.first) + " waits on " +
+                            semaphoreName(stall.sem) + " held by " + threadName(holder.key.first);
+                }
+                fprintf(stderr, "semaphore watchdog: wait-for cycle: %s\n", line.c_str());
+            } else if (visited[next] == 0) {
+                visit(next);
+            }
+        }
+        path.pop_back();
+        visited[i] = 2;
+    };
+    for (size_t i = 0; i < stalls.size(); i++) {
+        if (visited[i] == 0) visit(i);
+    }
+    r.reportedCycles.swap(cycles);
+
+    // A signal that went to the wrong semaphore shows up as a value above
+    // where it started, often next to the thread that needed it
+    if (!reported) return;
+    std::string unconsumed;
+    size_t listed = 0, more = 0;
+    for (std::unordered_set<Semaphore*>::const_iterator it = r.semaphores.begin(); it != r.semaphores.end(); ++it) {
+        Snapshot s = snapshot(*it);
+        if (s.value <= s.initial) continue;
+        if (listed == MAX_UNCONSUMED_LISTED) {
+            more++;
+            continue;
+        }
+        listed++;
+        unconsumed += (unconsumed.empty() ? "" : ", ") + semaphoreName(*it) + " (value " +
+                      std::to_string(s.value) + ", initially " + std::to_string(s.initial) + ")";
+    }
+    if (more > 0) unconsumed += " and " + std::to_string(more) + " more";
+    if (!unconsumed.empty()) {
+        fprintf(stderr, "semaphore watchdog: unconsumed signals: %s\n", unconsumed.c_str());
+    }
+}
+
+void nameSemaphoreThread(const std::string& name) {
+    SemaphoreThread* thread = SemaphoreRegistry::currentThread();
+    std::lock_guard<std::mutex> guard(registry().lock);
+    thread->name = name;
+}
+
+void startSemaphoreWatchdog(int thresholdMs) {
+    const char* env = getenv("SEM_WATCHDOG_MS");
+    if (env != NULL) thresholdMs = atoi(env);
+    if (thresholdMs <= 0) return;
+
+    Watchdog& w = watchdog();
+    std::lock_guard<std::mutex> guard(w.lock);
+    if (w.running) return;
+    w.running = true;
+    int64_t thresholdNs = thresholdMs * 1000000LL;
+    w.thread = std::thread([&w, thresholdNs]() {
+        // A few looks per threshold, so a stall is reported soon after it
+        // crosses it
+        std::chrono::nanoseconds period(std::max<int64_t>(thresholdNs / 4, 10000000));
+        std::unique_lock<std::mutex> lock(w.lock);
+        while (!w.stopping.wait_for(lock, period, [&w]() { return !w.running; })) {
+            lock.unlock();
+            SemaphoreRegistry::scan(thresholdNs);
+            lock.lock();
+        }
+    });
+}
+
+void stopSemaphoreWatchdog() {
+    Watchdog& w = watchdog();
+    {
+        std::lock_guard<std::mutex> guard(w.lock);
+        if (!w.running) return;
+        w.running = false;
+    }
+    w.stopping.notify_all();
+    w.thread.join();
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef __SEMAPHORE_DEBUG_H_
+#define __SEMAPHORE_DEBUG_H_
+#include <string>
+#ifdef SEMAPHORE_DEBUG
+#include <atomic>
+#include <cstdint>
+#endif
+
+// Deadlock and lost-wakeup detector for Semaphore, compiled in with
+// -DSEMAPHORE_DEBUG (make SEM_DEBUG=1, or cmake -DOSC_SEMAPHORE_DEBUG=ON).
+// Without it these functions do nothing.
+//
+// A watchdog thread looks at the threads blocked in Semaphore::wait() and
+// reports to stderr:
+//   - a thread blocked longer than the threshold, with the semaphore's
+//     name, value, number of waiters and who signaled it last;
+//   - wait-for cycles: a thread waiting on a semaphore held (waited on and
+//     not yet signaled) by a thread that is itself waiting, back round to
+//     the first;
+//   - semaphores holding more signals than they started with, which is
+//     where a wakeup meant for a stalled thread usually went.
+// Each stalled wait is reported once. The cost on the semaphore paths is a
+// few stores under the lock Semaphore already takes, plus a clock read when
+// a thread signals or has to block, so it can stay on in soak tests.
+
+#ifdef SEMAPHORE_DEBUG
+
+// Name the calling thread in reports ("teller 2"); unnamed threads are
+// reported as "thread #n"
+void nameSemaphoreThread(const std::string& name);
+
+// Start the watchdog, reporting waits longer than thresholdMs. The
+// SEM_WATCHDOG_MS environment variable overrides the threshold; 0 disables.
+void startSemaphoreWatchdog(int thresholdMs);
+void stopSemaphoreWatchdog();
+
+class Semaphore;
+
+// What the watchdog knows about a thread that has used a semaphore
+struct SemaphoreThread {
+    uint64_t serial;  // Never reused, unlike thread ids
+    std::string name;
+    std::atomic<Semaphore*> waitingOn;  // NULL unless blocked in wait()
+    std::atomic<int64_t> sinceNs;
+    std::atomic<uint64_t> waits;  // Blocking waits so far, to report each once
+
+    explicit SemaphoreThread(uint64_t serial)
+        : serial(serial), waitingOn(NULL), sinceNs(0), waits(0) {}
+};
+
+// Used by Semaphore
+class SemaphoreRegistry {
+    public:
+        static void add(Semaphore* sem);
+        static void remove(Semaphore* sem);
+        // The calling thread's record, created on first use. Must not be
+        // called with a semaphore's lock held.
+        static SemaphoreThread* currentThread();
+        static int64_t nowNs();
+        // Reports waits longer than thresholdNs; the watchdog calls this
+        // a few times per threshold
+        static void scan(int64_t thresholdNs);
+};
+
+#else
+
+inline void nameSemaphoreThread(const std::string&) {}
+inline void startSemaphoreWatchdog(int) {}
+inline void stopSemaphoreWatchdog() {}
+#endif
+
+#endif